@@ -0,0 +1,258 @@
+#include <iostream>
+#include <fstream>
+#include <format>
+#include <random>
+#include <thread>
+#include <string>
+#include <vector>
+#include <cmath>
+#include "harness.h"
+#include "linear_algebra/lin_alg.h"
+#include "neural_network/neural_network.h"
+#include "diagnostics/memory.h"
+
+// Every benchmark runs on generated data and seeded networks, so the suite needs no input files and every run
+// does the same work - a training benchmark cannot get faster or slower through a lucky initialization. Names are <group>/<operation>/<shape>, use --filter to run a subset.
+// Benchmarks that work in preallocated memory are run as allocation free and fail when they allocate
+
+namespace {
+
+    lin_alg::Matrix random_matrix(size_t rows, size_t cols, std::mt19937& rng){
+        std::uniform_real_distribution<double> value(-1.0, 1.0);
+        lin_alg::Matrix m(rows, cols);
+        double* values = m.get_data();
+        for (size_t i = 0; i < rows * cols; i++) values[i] = value(rng);
+        return m;
+    }
+
+    lin_alg::Vector random_vector(size_t size, std::mt19937& rng){
+        std::uniform_real_distribution<double> value(-1.0, 1.0);
+        lin_alg::Vector v(size);
+        for (size_t i = 0; i < size; i++) v(i) = value(rng);
+        return v;
+    }
+
+    /// @brief Rows of inputs in [0, 1] and smooth targets in [0, 1] a sigmoid network can learn
+    neural_network::Dataset synthetic_dataset(size_t rows, size_t inputs, size_t outputs, std::mt19937& rng){
+        std::uniform_real_distribution<double> value(0.0, 1.0);
+        neural_network::Dataset data(rows, inputs, outputs);
+        double* features = data.get_features().get_data();
+        double* targets = data.get_targets().get_data();
+        for (size_t r = 0; r < rows; r++){
+            double sum = 0;
+            for (size_t c = 0; c < inputs; c++){
+                features[r * inputs + c] = value(rng);
+                sum += features[r * inputs + c] * (c % 2 ? -1 : 1);
+            }
+            for (size_t c = 0; c < outputs; c++) targets[r * outputs + c] = 1 / (1 + std::exp(-sum / double(c + 1)));
+        }
+        return data;
+    }
+
+    struct Shape{
+        size_t m, k, n;     // (m x k) * (k x n)
+
+        std::string name() const { return std::format("{}x{}x{}", m, k, n); }
+    };
+
+    void bench_lin_alg(bench::Harness& harness){
+        // the shapes the default network trains and predicts with, then square ones
+        const std::vector<Shape> shapes = {{20, 4, 10}, {20, 10, 6}, {20, 6, 1}, {256, 10, 6}, {64, 64, 64}, {256, 256, 256}};
+        std::mt19937 rng(1);
+
+        for (const Shape& s : shapes){
+            lin_alg::Matrix a = random_matrix(s.m, s.k, rng);
+            lin_alg::Matrix b = random_matrix(s.k, s.n, rng);
+            lin_alg::Matrix c = random_matrix(s.m, s.n, rng);
+            lin_alg::Matrix d = random_matrix(s.m, s.n, rng);
+            lin_alg::Matrix out(s.m, s.n);
+            lin_alg::Matrix a_t(s.k, s.m);
+            lin_alg::Vector bias = random_vector(s.n, rng);
+            lin_alg::Vector sums(s.n);
+            lin_alg::Vector x = random_vector(s.k, rng);
+            const double flops = 2.0 * s.m * s.k * s.n;
+            const double elements = double(s.m) * s.n;
+            const std::string shape = s.name();
+
+            harness.run("lin_alg/multiply/" + shape, [&] { bench::keep((a * b).get_data()[0]); }, flops);
+            harness.run("lin_alg/gemm/" + shape, [&] { lin_alg::gemm(a, b, out); bench::keep(out.get_data()[0]); }, flops, true);
+            harness.run("lin_alg/matrix_vector/" + shape, [&] { bench::keep((a * x)(0)); }, 2.0 * s.m * s.k);
+            harness.run("lin_alg/vector_matrix/" + shape, [&] { bench::keep((x * b)(0)); }, 2.0 * s.k * s.n);
+            harness.run("lin_alg/transpose/" + shape, [&] { bench::keep(a.transpose().get_data()[0]); }, double(s.m) * s.k);
+            harness.run("lin_alg/transpose_into/" + shape, [&] { lin_alg::transpose_into(a, a_t); bench::keep(a_t.get_data()[0]); },
+                double(s.m) * s.k, true);
+            harness.run("lin_alg/elementwise_mult/" + shape, [&] { bench::keep(c.elementwise_mult(d).get_data()[0]); }, elements);
+            harness.run("lin_alg/elementwise_add/" + shape, [&] { bench::keep(c.elementwise_add(bias).get_data()[0]); }, elements);
+            harness.run("lin_alg/add_row_vector/" + shape, [&] { lin_alg::add_row_vector(out, bias); bench::keep(out.get_data()[0]); },
+                elements, true);
+            harness.run("lin_alg/subtract/" + shape, [&] { bench::keep((c - d).get_data()[0]); }, elements);
+            harness.run("lin_alg/scale/" + shape, [&] { bench::keep((c * 0.5).get_data()[0]); }, elements);
+            harness.run("lin_alg/add_assign/" + shape, [&] { c += d; bench::keep(c.get_data()[0]); }, elements, true);
+            harness.run("lin_alg/subtract_assign/" + shape, [&] { c -= d; bench::keep(c.get_data()[0]); }, elements, true);
+            harness.run("lin_alg/apply_to_elements/" + shape, [&] {
+                bench::keep(c.apply_to_elements([](double v) { return 1 / (1 + std::exp(-v)); }).get_data()[0]);
+            }, elements);
+            harness.run("lin_alg/collapse_rows/" + shape, [&] { bench::keep(c.collapse_rows()(0)); }, elements);
+            harness.run("lin_alg/column_sums/" + shape, [&] { lin_alg::column_sums(c, sums); bench::keep(sums(0)); }, elements, true);
+            harness.run("lin_alg/averaged_vector/" + shape, [&] { bench::keep(c.averaged_vector()(0)); }, elements);
+            harness.run("lin_alg/row_vector/" + shape, [&] { bench::keep(lin_alg::Vector::from_matrix_row(c, s.m - 1)(0)); }, double(s.n));
+            harness.run("lin_alg/vector_add/" + shape, [&] { bench::keep((bias + bias)(0)); }, double(s.n));
+            harness.run("lin_alg/vector_scale/" + shape, [&] { bench::keep((bias * 0.5)(0)); }, double(s.n));
+            harness.run("lin_alg/vector_add_assign/" + shape, [&] { sums += bias; bench::keep(sums(0)); }, double(s.n), true);
+            harness.run("lin_alg/vector_subtract_assign/" + shape, [&] { sums -= bias; bench::keep(sums(0)); }, double(s.n), true);
+            harness.run("lin_alg/vector_transpose/" + shape, [&] { bench::keep(bias.transpose().get_data()[0]); }, double(s.n));
+        }
+    }
+
+    void bench_layers(bench::Harness& harness){
+        const std::vector<std::pair<size_t, size_t>> layer_shapes = {{4, 10}, {10, 6}, {64, 64}};
+        const size_t steps = 64;
+        std::mt19937 rng(2);
+
+        for (auto [inputs, outputs] : layer_shapes){
+            for (size_t batch : {20, 256}){
+                const std::string shape = std::format("{}x{}/b{}", inputs, outputs, batch);
+
+                // a single-layer network, so forward and backward are those of the layer the training uses
+                neural_network::NeuralNetwork network(static_cast<int>(batch), {{inputs, outputs, std::make_shared<neural_network::Sigmoid>()}}, 2);
+                lin_alg::Matrix input = random_matrix(batch, inputs, rng);
+                harness.run("layer/forward/" + shape, [&] { bench::keep(network.predict_batch(input).get_data()[0]); }, double(batch));
+
+                // forward, backward and update, steps batches per call. The batches view the data set and the step works in
+                // the network's reused buffers, so the steady state allocates nothing
+                neural_network::Dataset data = synthetic_dataset(batch * steps, inputs, outputs, rng);
+                neural_network::EpochSampler sampler(data, batch, neural_network::SamplingMode::Sequential);
+                harness.run("layer/train_step/" + shape, [&] {
+                    for (size_t b = 0; b < sampler.get_batch_count(); b++) bench::keep(network.train_batch(sampler.gather(b), 0.01));
+                }, double(steps), true);
+            }
+        }
+    }
+
+    void bench_data(bench::Harness& harness){
+        std::mt19937 rng(5);
+        neural_network::Dataset data = synthetic_dataset(20000, 4, 1, rng);
+
+        for (neural_network::SamplingMode mode : {neural_network::SamplingMode::Sequential, neural_network::SamplingMode::Shuffle}){
+            const char* mode_name = mode == neural_network::SamplingMode::Sequential ? "sequential" : "shuffle";
+            neural_network::EpochSampler sampler(data, 20, mode);
+            neural_network::RandomStream epoch_rng(6, neural_network::RandomStreamKind::EpochOrder, 0);
+            sampler.start_epoch(epoch_rng);
+
+            // batches are views or land in the sampler's buffer, both steady states allocate nothing
+            size_t b = 0;
+            harness.run(std::format("data/gather_batch/20000x4/b20/{}", mode_name), [&] {
+                bench::keep(sampler.gather(b).inputs.get_data()[0]);
+                b = (b + 1) % sampler.get_batch_count();
+            }, 20, true);
+            harness.run(std::format("data/start_epoch/20000x4/{}", mode_name), [&] { sampler.start_epoch(epoch_rng); },
+                double(data.get_row_count()));
+        }
+    }
+
+    void bench_training(bench::Harness& harness){
+        std::mt19937 rng(3);
+        neural_network::Dataset data = synthetic_dataset(20000, 4, 1, rng);
+        const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (size_t threads : {size_t(1), max_threads}){
+            neural_network::NeuralNetwork network(20, {
+                {4, 10, std::make_shared<neural_network::Sigmoid>()},
+                {10, 6, std::make_shared<neural_network::Sigmoid>()},
+                {6, 1, std::make_shared<neural_network::Sigmoid>()}
+            }, 3);
+            neural_network::TrainingOptions options;
+            options.schedule = std::make_shared<neural_network::ConstantSchedule>(0.05);
+            options.threads = threads;
+            harness.run(std::format("training/epoch/20000x4/b20/t{}", threads), [&] { network.train(data, options); }, double(data.get_row_count()));
+            if (max_threads == 1) break;
+        }
+    }
+
+    void bench_inference(bench::Harness& harness){
+        std::mt19937 rng(4);
+        neural_network::Dataset data = synthetic_dataset(100000, 4, 1, rng);
+        neural_network::NeuralNetwork network(20, {
+            {4, 10, std::make_shared<neural_network::Sigmoid>()},
+            {10, 6, std::make_shared<neural_network::Sigmoid>()},
+            {6, 1, std::make_shared<neural_network::Sigmoid>()}
+        }, 4);
+
+        harness.run("inference/predict_batch/100000x4", [&] { bench::keep(network.predict_batch(data.get_features()).get_data()[0]); },
+            double(data.get_row_count()));
+        // the work test() does, without the printing
+        harness.run("inference/test/100000x4", [&] { bench::keep(network.evaluate(data).rmse); }, double(data.get_row_count()));
+    }
+
+    int usage(){
+        std::cerr << "Usage: nn_bench [--out results.json] [--compare baseline.json] [--threshold 0.05] [--filter text]\n"
+                     "                [--repetitions n] [--warmup n] [--cpu n]\n"
+                     "--cpu pins the benchmarks to one core, which also confines the thread pools to it" << std::endl;
+        return 2;
+    }
+}
+
+int main(int argc, char* argv[]){
+    bench::BenchOptions options;
+    std::string out_path = "nn_bench.json";
+    std::string baseline_path;
+    double threshold = 0.05;
+
+    try{
+        for (int i = 1; i < argc; i++){
+            std::string arg = argv[i];
+            if (i + 1 >= argc) return usage();
+            std::string value = argv[++i];
+
+            if (arg == "--out") out_path = value;
+            else if (arg == "--compare") baseline_path = value;
+            else if (arg == "--threshold") threshold = std::stod(value);
+            else if (arg == "--filter") options.filter = value;
+            else if (arg == "--repetitions") options.repetitions = std::stoul(value);
+            else if (arg == "--warmup") options.warmup = std::stoul(value);
+            else if (arg == "--cpu") options.cpu = std::stoi(value);
+            else return usage();
+        }
+
+        bench::Harness harness(options);
+        bench_lin_alg(harness);
+        bench_layers(harness);
+        bench_data(harness);
+        bench_training(harness);
+        bench_inference(harness);
+
+        size_t failures = 0;
+        std::cout << std::format("{:<44} {:>14} {:>10} {:>14} {:>12}", "benchmark", "median ns", "MAD %", "items/s", "allocs/call") << std::endl;
+        for (const bench::BenchResult& r : harness.get_results()){
+            std::cout << std::format("{:<44} {:>14.1f} {:>10.2f} {:>14.4g} {:>12.2f}{}", r.name, r.median_ns,
+                r.median_ns > 0 ? 100 * r.mad_ns / r.median_ns : 0, r.items_per_second, r.allocations_per_call,
+                r.failed ? "  FAILED: allocates in steady state" : "") << std::endl;
+            if (r.failed) failures++;
+        }
+        if (!lin_alg::allocation_tracking) std::cout << "Allocation tracking is compiled out (configure with -DNN_ALLOC_TRACKING=ON), allocations were not counted" << std::endl;
+        std::cout << "Peak RSS: " << diagnostics::peak_rss_bytes() << " bytes" << std::endl;
+
+        std::ofstream out(out_path);
+        if (!out.is_open()) throw std::runtime_error("Could not open file: " + out_path);
+        harness.write_json(out);
+        std::cout << "Results written to " << out_path << std::endl;
+
+        if (!baseline_path.empty()){
+            std::vector<bench::Regression> regressions = bench::compare(bench::read_json(baseline_path), harness.get_results(), threshold);
+            for (const bench::Regression& r : regressions){
+                std::cout << std::format("REGRESSION {}: {:.1f} ns -> {:.1f} ns (+{:.1f}%)", r.name, r.baseline_ns, r.current_ns, 100 * r.change) << std::endl;
+            }
+            std::cout << regressions.size() << " regression(s) against " << baseline_path << " (threshold " << 100 * threshold << "%)" << std::endl;
+            if (!regressions.empty()) return 1;
+        }
+        if (failures > 0){
+            std::cout << failures << " allocation free benchmark(s) allocated" << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::exception& e){
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include "harness.h"
+#include "../linear_algebra/allocation.h"
+#include "../diagnostics/memory.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <format>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace bench{
+
+    static volatile double sink;
+
+    void keep(double value){
+        sink = value;
+    }
+
+    bool pin_to_cpu(int cpu){
+        if (cpu < 0) return false;
+        #ifdef _WIN32
+        return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+        #elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+        #else
+        return false;
+        #endif
+    }
+
+    static double median(std::vector<double> values){
+        std::sort(values.begin(), values.end());
+        const size_t mid = values.size() / 2;
+        return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+    }
+
+    Harness::Harness(BenchOptions options) : options(std::move(options)) {
+        if (this->options.repetitions < 1) throw std::invalid_argument("A benchmark needs at least one repetition");
+        if (this->options.cpu >= 0 && !pin_to_cpu(this->options.cpu)){
+            throw std::runtime_error(std::format("Could not pin the benchmark thread to CPU {}", this->options.cpu));
+        }
+    }
+
+    void Harness::run(const std::string& name, const std::function<void()>& fn, double items, bool allocation_free){
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) return;
+
+        using clock = std::chrono::steady_clock;
+        auto time_calls = [&](size_t calls) {
+            auto start = clock::now();
+            for (size_t i = 0; i < calls; i++) fn();
+            return std::chrono::duration<double>(clock::now() - start).count();
+        };
+
+        // double the calls until a repetition is long enough for the clock resolution not to matter
+        size_t calls = 1;
+        while (time_calls(calls) < options.min_repetition_seconds && calls < (size_t(1) << 30)) calls *= 2;
+
+        for (size_t i = 0; i < options.warmup; i++) time_calls(calls);
+
+        // process-wide counts, so allocations of worker threads are included
+        const lin_alg::MemoryFootprint before = lin_alg::memory_footprint();
+        std::vector<double> per_call_ns;
+        for (size_t i = 0; i < options.repetitions; i++){
+            per_call_ns.push_back(time_calls(calls) * 1e9 / calls);
+        }
+        const lin_alg::MemoryFootprint after = lin_alg::memory_footprint();
+        const double total_calls = double(calls) * options.repetitions;
+
+        BenchResult result;
+        result.name = name;
+        result.calls_per_repetition = calls;
+        result.repetitions = options.repetitions;
+        result.median_ns = median(per_call_ns);
+        result.min_ns = *std::min_element(per_call_ns.begin(), per_call_ns.end());
+
+        std::vector<double> deviations;
+        for (double ns : per_call_ns) deviations.push_back(std::abs(ns - result.median_ns));
+        result.mad_ns = median(deviations);
+        result.items_per_second = result.median_ns > 0 ? items * 1e9 / result.median_ns : 0;
+        result.allocations_per_call = (after.allocations - before.allocations) / total_calls;
+        result.allocated_bytes_per_call = (after.allocated_bytes - before.allocated_bytes) / total_calls;
+        result.allocation_free = allocation_free;
+        result.failed = allocation_free && after.allocations != before.allocations;
+
+        results.push_back(result);
+    }
+
+    void Harness::write_json(std::ostream& out) const{
+        out << std::format("{{\"peak_rss_bytes\": {}, \"benchmarks\": [\n", diagnostics::peak_rss_bytes());
+        for (size_t i = 0; i < results.size(); i++){
+            const BenchResult& r = results[i];
+            out << std::format(R"(  {{"name": "{}", "calls_per_repetition": {}, "repetitions": {}, "median_ns": {}, "mad_ns": {}, "min_ns": {}, "items_per_second": {}, )",
+                r.name, r.calls_per_repetition, r.repetitions, r.median_ns, r.mad_ns, r.min_ns, r.items_per_second);
+            out << std::format(R"("allocations_per_call": {}, "allocated_bytes_per_call": {}, "allocation_free": {}, "failed": {}}})",
+                r.allocations_per_call, r.allocated_bytes_per_call, r.allocation_free, r.failed);
+            out << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "]}\n";
+    }
+
+    // the value of "key": in a result line of write_json
+    static std::string field(const std::string& line, const std::string& key){
+        const std::string marker = "\"" + key + "\": ";
+        size_t start = line.find(marker);
+        if (start == std::string::npos) throw std::runtime_error(std::format("Benchmark result without {}: {}", key, line));
+        start += marker.size();
+
+        if (line[start] == '"'){
+            size_t end = line.find('"', start + 1);
+            return line.substr(start + 1, end - start - 1);
+        }
+        size_t end = line.find_first_of(",}", start);
+        return line.substr(start, end - start);
+    }
+
+    // fields added after the first version of the format, absent from older baselines
+    static std::string optional_field(const std::string& line, const std::string& key, const std::string& fallback){
+        return line.find("\"" + key + "\": ") == std::string::npos ? fallback : field(line, key);
+    }
+
+    std::vector<BenchResult> read_json(const std::string& path){
+        std::ifstream in(path);
+        if (!in.is_open()) throw std::runtime_error("Could not open file: " + path);
+
+        std::vector<BenchResult> results;
+        std::string line;
+        while (std::getline(in, line)){
+            if (line.find("\"name\": ") == std::string::npos) continue;
+
+            BenchResult r;
+            r.name = field(line, "name");
+            r.calls_per_repetition = std::stoull(field(line, "calls_per_repetition"));
+            r.repetitions = std::stoull(field(line, "repetitions"));
+            r.median_ns = std::stod(field(line, "median_ns"));
+            r.mad_ns = std::stod(field(line, "mad_ns"));
+            r.min_ns = std::stod(field(line, "min_ns"));
+            r.items_per_second = std::stod(field(line, "items_per_second"));
+            r.allocations_per_call = std::stod(optional_field(line, "allocations_per_call", "0"));
+            r.allocated_bytes_per_call = std::stod(optional_field(line, "allocated_bytes_per_call", "0"));
+            r.allocation_free = optional_field(line, "allocation_free", "false") == "true";
+            r.failed = optional_field(line, "failed", "false") == "true";
+            results.push_back(r);
+        }
+        return results;
+    }
+
+    std::vector<Regression> compare(const std::vector<BenchResult>& baseline, const std::vector<BenchResult>& current, double threshold){
+        std::vector<Regression> regressions;
+        for (const BenchResult& now : current){
+            auto before = std::find_if(baseline.begin(), baseline.end(), [&](const BenchResult& b) { return b.name == now.name; });
+            if (before == baseline.end() || before->median_ns <= 0) continue;
+
+            const double change = now.median_ns / before->median_ns - 1;
+            const double noise = 3 * std::max(now.mad_ns, before->mad_ns);
+            if (change > threshold && now.median_ns - before->median_ns > noise){
+                regressions.push_back(Regression{now.name, before->median_ns, now.median_ns, change});
+            }
+        }
+        return regressions;
+    }
+}
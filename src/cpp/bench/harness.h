@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <ostream>
+#include <cstddef>
+
+namespace bench{
+
+    struct BenchOptions{
+        size_t warmup = 3;                  // untimed repetitions before measuring
+        size_t repetitions = 15;
+        double min_repetition_seconds = 0.01;   // calls per repetition are raised until one repetition lasts this long
+        int cpu = -1;                       // core the benchmark thread is pinned to, -1 leaves scheduling alone. Threads started
+                                            // afterwards inherit the pin, so only set it for single-threaded benchmarks
+        std::string filter;                 // only benchmarks whose name contains this run
+    };
+
+    /// @brief Timings of one benchmark, per call
+    struct BenchResult{
+        std::string name;
+        size_t calls_per_repetition = 0;
+        size_t repetitions = 0;
+        double median_ns = 0;
+        double mad_ns = 0;                  // median absolute deviation of the repetitions
+        double min_ns = 0;
+        double items_per_second = 0;        // items processed per call (rows, elements...) at the median time
+        double allocations_per_call = 0;    // Matrix and Vector storage allocations of the timed repetitions, all threads
+        double allocated_bytes_per_call = 0;
+        bool allocation_free = false;       // the benchmark must not allocate once warmed up
+        bool failed = false;                // it was allocation free and allocated anyway
+    };
+
+    /// @brief A benchmark that is slower than its baseline by more than the threshold and the noise
+    struct Regression{
+        std::string name;
+        double baseline_ns = 0;
+        double current_ns = 0;
+        double change = 0;                  // current / baseline - 1
+    };
+
+    /// @brief Times functions with warmup and repetitions and keeps the median and MAD of every benchmark.
+    /// Median and MAD are used instead of mean and standard deviation so a few disturbed repetitions do not move them
+    class Harness{
+        private:
+            BenchOptions options;
+            std::vector<BenchResult> results;
+
+        public:
+            /// @brief Pins the calling thread to options.cpu unless it is -1
+            explicit Harness(BenchOptions options);
+
+            /// @param items Work done by one call of fn, reported as items_per_second
+            /// @param allocation_free Fails the benchmark when a timed call allocates Matrix or Vector storage.
+            /// Allocations are only counted in builds with allocation tracking (see lin_alg/allocation.h). Of the training step
+            /// only the single-threaded NeuralNetwork::train_batch without activation checkpointing is allocation free;
+            /// the sharded parallel step and the recompute of checkpointed segments still allocate
+            void run(const std::string& name, const std::function<void()>& fn, double items = 1, bool allocation_free = false);
+
+            const std::vector<BenchResult>& get_results() const { return results; }
+
+            /// @brief {"peak_rss_bytes": n, "benchmarks": [...]} with one result object per line
+            void write_json(std::ostream& out) const;
+    };
+
+    /// @brief Restricts the calling thread to one core. False when the platform does not support it or the call fails
+    bool pin_to_cpu(int cpu);
+
+    /// @brief Reads a file written by Harness::write_json
+    std::vector<BenchResult> read_json(const std::string& path);
+
+    /// @brief Benchmarks present in both sets whose median got slower by more than threshold (0.05 = 5%)
+    /// and by more than three MADs of either run, so noisy benchmarks are not flagged for ordinary jitter
+    std::vector<Regression> compare(const std::vector<BenchResult>& baseline, const std::vector<BenchResult>& current, double threshold);
+
+    /// @brief Keeps the compiler from optimizing away a computation whose result is otherwise unused
+    void keep(double value);
+}
@@ -0,0 +1,55 @@
+#include "memory.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#include <fstream>
+#endif
+
+namespace diagnostics{
+
+    #ifdef _WIN32
+
+    static PROCESS_MEMORY_COUNTERS memory_counters(){
+        PROCESS_MEMORY_COUNTERS counters{};
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters;
+    }
+
+    size_t peak_rss_bytes(){
+        return memory_counters().PeakWorkingSetSize;
+    }
+
+    size_t current_rss_bytes(){
+        return memory_counters().WorkingSetSize;
+    }
+
+    #else
+
+    size_t peak_rss_bytes(){
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+
+        #ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);         // bytes on macOS
+        #else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;  // kilobytes on Linux
+        #endif
+    }
+
+    size_t current_rss_bytes(){
+        // the second field of statm is the resident page count
+        std::ifstream statm("/proc/self/statm");
+        size_t total_pages = 0;
+        size_t resident_pages = 0;
+        if (!(statm >> total_pages >> resident_pages)) return 0;
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    #endif
+}
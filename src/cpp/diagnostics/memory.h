@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+namespace diagnostics{
+
+    /// @brief The largest resident set size (physical memory) the process has had so far, in bytes. 0 when unknown
+    size_t peak_rss_bytes();
+
+    /// @brief The current resident set size of the process in bytes. 0 when unknown
+    size_t current_rss_bytes();
+}
@@ -0,0 +1,139 @@
+#include "telemetry.h"
+#include "memory.h"
+#include <fstream>
+#include <format>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+namespace diagnostics{
+
+    const char* phase_name(Phase phase){
+        switch (phase){
+            case Phase::BatchAssembly: return "batch_assembly";
+            case Phase::Forward: return "forward";
+            case Phase::Backward: return "backward";
+            case Phase::GradientReduction: return "gradient_reduction";
+            case Phase::Update: return "update";
+            case Phase::Validation: return "validation";
+            case Phase::Checkpoint: return "checkpoint";
+        }
+        return "unknown";
+    }
+
+    void LayerTimings::enable(size_t layer_count){
+        forward_seconds.assign(layer_count, 0.0);
+        backward_seconds.assign(layer_count, 0.0);
+    }
+
+    TrainingTelemetry::TrainingTelemetry(size_t layer_count) : layer_count(layer_count) {}
+
+    void TrainingTelemetry::begin_epoch(int epoch, double learning_rate){
+        current = EpochTelemetry{};
+        current.epoch = epoch;
+        current.learning_rate = learning_rate;
+        current.forward_layer_seconds.assign(layer_count, 0.0);
+        current.backward_layer_seconds.assign(layer_count, 0.0);
+        loss_sum = 0;
+        loss_count = 0;
+        lin_alg::reset_peak_live_bytes();
+        epoch_start = std::chrono::steady_clock::now();
+    }
+
+    void TrainingTelemetry::add_batch(size_t rows, double batch_loss, size_t terms){
+        current.samples += rows;
+        loss_sum += batch_loss;
+        loss_count += terms;
+    }
+
+    void TrainingTelemetry::collect(LayerTimings& timings){
+        for (size_t i = 0; i < layer_count && i < timings.forward_seconds.size(); i++){
+            current.forward_layer_seconds[i] += timings.forward_seconds[i];
+            current.backward_layer_seconds[i] += timings.backward_seconds[i];
+            current.phase_seconds[static_cast<size_t>(Phase::Forward)] += timings.forward_seconds[i];
+            current.phase_seconds[static_cast<size_t>(Phase::Backward)] += timings.backward_seconds[i];
+        }
+        std::fill(timings.forward_seconds.begin(), timings.forward_seconds.end(), 0.0);
+        std::fill(timings.backward_seconds.begin(), timings.backward_seconds.end(), 0.0);
+
+        current.phase_allocations[static_cast<size_t>(Phase::Forward)] += timings.forward_allocations;
+        current.phase_allocations[static_cast<size_t>(Phase::Backward)] += timings.backward_allocations;
+        timings.forward_allocations = {};
+        timings.backward_allocations = {};
+    }
+
+    void TrainingTelemetry::end_epoch(){
+        current.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - epoch_start).count();
+        current.samples_per_second = current.seconds > 0 ? current.samples / current.seconds : 0;
+        current.loss = loss_count > 0 ? loss_sum / loss_count : 0;
+        current.peak_live_bytes = lin_alg::memory_footprint().peak_live_bytes;
+        current.rss_bytes = current_rss_bytes();
+        epochs.push_back(current);
+    }
+
+    // JSON has no inf or nan, a diverged loss is written as null
+    static std::string json_number(double value){
+        return std::isfinite(value) ? std::format("{}", value) : "null";
+    }
+
+    static std::string json_array(const std::vector<double>& values){
+        std::string out = "[";
+        for (size_t i = 0; i < values.size(); i++){
+            out += std::format("{}{}", i > 0 ? "," : "", json_number(values[i]));
+        }
+        return out + "]";
+    }
+
+    void TrainingTelemetry::write_json_lines(std::ostream& out) const{
+        for (const EpochTelemetry& epoch : epochs){
+            out << std::format(R"({{"epoch":{},"learning_rate":{},"samples":{},"seconds":{},"samples_per_second":{},"loss":{},"phases":{{)",
+                epoch.epoch, json_number(epoch.learning_rate), epoch.samples, json_number(epoch.seconds),
+                json_number(epoch.samples_per_second), json_number(epoch.loss));
+            for (size_t p = 0; p < phase_count; p++){
+                out << std::format(R"({}"{}":{})", p > 0 ? "," : "", phase_name(static_cast<Phase>(p)), json_number(epoch.phase_seconds[p]));
+            }
+            out << R"(},"allocations":{)";
+            for (size_t p = 0; p < phase_count; p++){
+                out << std::format(R"({}"{}":{})", p > 0 ? "," : "", phase_name(static_cast<Phase>(p)), epoch.phase_allocations[p].allocations);
+            }
+            out << R"(},"allocated_bytes":{)";
+            for (size_t p = 0; p < phase_count; p++){
+                out << std::format(R"({}"{}":{})", p > 0 ? "," : "", phase_name(static_cast<Phase>(p)), epoch.phase_allocations[p].bytes);
+            }
+            out << std::format(R"(}},"peak_live_bytes":{},"rss_bytes":{})", epoch.peak_live_bytes, epoch.rss_bytes);
+            out << R"(,"forward_layers":)" << json_array(epoch.forward_layer_seconds)
+                << R"(,"backward_layers":)" << json_array(epoch.backward_layer_seconds) << "}\n";
+        }
+    }
+
+    void TrainingTelemetry::write_csv(std::ostream& out) const{
+        out << "epoch,learning_rate,samples,seconds,samples_per_second,loss";
+        for (size_t p = 0; p < phase_count; p++) out << "," << phase_name(static_cast<Phase>(p)) << "_seconds";
+        for (size_t i = 0; i < layer_count; i++) out << ",forward_layer" << i << "_seconds";
+        for (size_t i = 0; i < layer_count; i++) out << ",backward_layer" << i << "_seconds";
+        for (size_t p = 0; p < phase_count; p++) out << "," << phase_name(static_cast<Phase>(p)) << "_allocations";
+        for (size_t p = 0; p < phase_count; p++) out << "," << phase_name(static_cast<Phase>(p)) << "_allocated_bytes";
+        out << ",peak_live_bytes,rss_bytes\n";
+
+        for (const EpochTelemetry& epoch : epochs){
+            out << std::format("{},{},{},{},{},{}", epoch.epoch, epoch.learning_rate, epoch.samples, epoch.seconds,
+                epoch.samples_per_second, epoch.loss);
+            for (double seconds : epoch.phase_seconds) out << std::format(",{}", seconds);
+            for (double seconds : epoch.forward_layer_seconds) out << std::format(",{}", seconds);
+            for (double seconds : epoch.backward_layer_seconds) out << std::format(",{}", seconds);
+            for (const lin_alg::AllocationCounts& counts : epoch.phase_allocations) out << std::format(",{}", counts.allocations);
+            for (const lin_alg::AllocationCounts& counts : epoch.phase_allocations) out << std::format(",{}", counts.bytes);
+            out << std::format(",{},{}\n", epoch.peak_live_bytes, epoch.rss_bytes);
+        }
+    }
+
+    void TrainingTelemetry::write(const std::string& path) const{
+        std::ofstream out(path, std::ios::trunc);
+        if (!out.is_open()) throw std::runtime_error(std::format("Could not open telemetry file for writing: {}", path));
+
+        if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0) write_csv(out);
+        else write_json_lines(out);
+
+        if (!out) throw std::runtime_error(std::format("Could not write telemetry file: {}", path));
+    }
+}
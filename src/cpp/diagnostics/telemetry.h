@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <ostream>
+#include <cstddef>
+#include "../linear_algebra/allocation.h"
+
+namespace diagnostics{
+
+    // Telemetry is compiled in with -DNN_TELEMETRY (the NN_TELEMETRY CMake option). Without it every timer below
+    // collapses to nothing and training records no telemetry even when asked to
+    #ifdef NN_TELEMETRY
+    inline constexpr bool telemetry_compiled = true;
+    #else
+    inline constexpr bool telemetry_compiled = false;
+    #endif
+
+    /// @brief The parts of a training step that are timed separately
+    enum class Phase{
+        BatchAssembly,      // gathering the rows of a batch
+        Forward,            // all layers, see EpochTelemetry::forward_layer_seconds
+        Backward,           // all layers, see EpochTelemetry::backward_layer_seconds
+        GradientReduction,  // summing the shard gradients of multi-threaded training
+        Update,             // the optimizer step
+        Validation,
+        Checkpoint          // snapshotting the training state, the write itself happens in the background
+    };
+
+    constexpr size_t phase_count = 7;
+
+    /// @brief snake_case name of a phase, as used in the JSON and CSV output
+    const char* phase_name(Phase phase);
+
+    /// @brief Where a ScopedPhase adds its time and the Matrix/Vector allocations its thread made; null members are skipped
+    struct PhaseSlot{
+        double* seconds = nullptr;
+        lin_alg::AllocationCounts* allocations = nullptr;
+    };
+
+    /// @brief Adds the time between construction and destruction, and the allocations made by the constructing thread
+    /// in between, to the slot. Does nothing when telemetry is compiled out
+    class ScopedPhase{
+        private:
+            PhaseSlot slot;
+            std::chrono::steady_clock::time_point start;
+            lin_alg::AllocationCounts allocations_at_start;
+
+        public:
+            explicit ScopedPhase(PhaseSlot slot) : slot(telemetry_compiled ? slot : PhaseSlot{}) {
+                if (this->slot.allocations) allocations_at_start = lin_alg::thread_allocations();
+                if (this->slot.seconds) start = std::chrono::steady_clock::now();
+            }
+
+            explicit ScopedPhase(double* seconds) : ScopedPhase(PhaseSlot{seconds, nullptr}) {}
+
+            ~ScopedPhase(){
+                if (slot.seconds) *slot.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (slot.allocations) *slot.allocations += lin_alg::thread_allocations() - allocations_at_start;
+            }
+
+            ScopedPhase(const ScopedPhase&) = delete;
+            ScopedPhase& operator=(const ScopedPhase&) = delete;
+    };
+
+    /// @brief Forward and backward seconds per layer and the allocations of the whole passes,
+    /// kept by every training thread for its own passes
+    struct LayerTimings{
+        std::vector<double> forward_seconds;
+        std::vector<double> backward_seconds;
+        lin_alg::AllocationCounts forward_allocations;
+        lin_alg::AllocationCounts backward_allocations;
+
+        /// @brief Starts timing layer_count layers; timings stay off until this is called
+        void enable(size_t layer_count);
+
+        /// @brief The slot of a layer for ScopedPhase, null while timing is off
+        double* forward(size_t layer) { return telemetry_compiled && !forward_seconds.empty() ? &forward_seconds[layer] : nullptr; }
+        double* backward(size_t layer) { return telemetry_compiled && !backward_seconds.empty() ? &backward_seconds[layer] : nullptr; }
+
+        /// @brief The slot of a whole pass, which only counts its allocations - the time is taken per layer
+        PhaseSlot forward_pass() { return PhaseSlot{nullptr, telemetry_compiled && !forward_seconds.empty() ? &forward_allocations : nullptr}; }
+        PhaseSlot backward_pass() { return PhaseSlot{nullptr, telemetry_compiled && !backward_seconds.empty() ? &backward_allocations : nullptr}; }
+    };
+
+    struct EpochTelemetry{
+        int epoch = 0;                  // 1-based
+        double learning_rate = 0;
+        size_t samples = 0;
+        double seconds = 0;
+        double samples_per_second = 0;
+        double loss = 0;                // mean loss of the training batches, before their updates (see neural_network::Loss)
+        std::array<double, phase_count> phase_seconds{};
+        std::array<lin_alg::AllocationCounts, phase_count> phase_allocations{};    // Matrix and Vector storage, 0 without NN_ALLOC_TRACKING
+        uint64_t peak_live_bytes = 0;   // most Matrix and Vector storage alive at once during the epoch, all threads (NN_ALLOC_TRACKING)
+        size_t rss_bytes = 0;           // resident set size of the process at the end of the epoch
+        std::vector<double> forward_layer_seconds;
+        std::vector<double> backward_layer_seconds;
+    };
+
+    /// @brief Collects the per-epoch telemetry of a training run. With several training threads the forward and
+    /// backward times are summed over the threads, so they can exceed the epoch's wall-clock time.
+    /// The peak of the live bytes is process-wide, so it includes whatever else runs during the epoch
+    class TrainingTelemetry{
+        private:
+            size_t layer_count;
+            std::vector<EpochTelemetry> epochs;
+            EpochTelemetry current;
+            double loss_sum = 0;
+            size_t loss_count = 0;
+            std::chrono::steady_clock::time_point epoch_start;
+
+        public:
+            explicit TrainingTelemetry(size_t layer_count);
+
+            void begin_epoch(int epoch, double learning_rate);
+
+            /// @brief The slot of a phase of the current epoch for ScopedPhase
+            PhaseSlot phase(Phase phase){
+                return PhaseSlot{&current.phase_seconds[static_cast<size_t>(phase)], &current.phase_allocations[static_cast<size_t>(phase)]};
+            }
+
+            /// @brief Counts a trained batch: rows samples whose loss summed to batch_loss over the given number of terms
+            void add_batch(size_t rows, double batch_loss, size_t terms);
+
+            /// @brief Moves the layer timings and pass allocations of a training thread into the current epoch and clears them
+            void collect(LayerTimings& timings);
+
+            void end_epoch();
+
+            const std::vector<EpochTelemetry>& get_epochs() const { return epochs; }
+
+            /// @brief One JSON object per epoch and line
+            void write_json_lines(std::ostream& out) const;
+
+            /// @brief A header line, then one row per epoch
+            void write_csv(std::ostream& out) const;
+
+            /// @brief Writes CSV when path ends in ".csv", JSON lines otherwise
+            void write(const std::string& path) const;
+    };
+}
@@ -0,0 +1,184 @@
+#include "trace.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <format>
+#include <stdexcept>
+#include <algorithm>
+
+namespace diagnostics{
+
+    std::atomic<bool> trace_recording{false};
+
+    namespace {
+
+        // a thread that recorded into a buffer, from its event number first on
+        struct BufferOwner{
+            size_t tid;
+            std::string name;
+            uint64_t first;
+        };
+
+        struct ThreadBuffer{
+            std::vector<TraceEvent> events;         // ring, empty until the thread's first span
+            std::atomic<uint64_t> written{0};       // events ever recorded, the next one goes to written % events.size()
+            // the threads whose events are in the ring, oldest first; the last one is the current or most recent owner
+            std::vector<BufferOwner> owners;
+            bool in_use = false;                    // owned by a running thread
+        };
+
+        struct TraceRegistry{
+            std::mutex mutex;
+            // never shrinks, so the spans of threads that already finished stay in the trace. The buffer of a finished
+            // thread is handed to the next new thread, which keeps the buffer count at the most threads alive at once
+            std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+            size_t next_tid = 1;                    // every thread gets its own tid, also when it reuses a buffer
+            size_t events_per_thread = 1 << 16;
+            uint64_t origin_ns = 0;
+        };
+
+        // never destroyed - threads may still record while static objects are torn down at exit
+        TraceRegistry& registry(){
+            static TraceRegistry* instance = new TraceRegistry();
+            return *instance;
+        }
+
+        // the calling thread's buffer, released for reuse when the thread exits
+        struct BufferLease{
+            ThreadBuffer* buffer = nullptr;
+
+            ~BufferLease(){
+                if (!buffer) return;
+                std::lock_guard<std::mutex> lock(registry().mutex);
+                buffer->in_use = false;
+            }
+        };
+
+        thread_local BufferLease owner;
+
+        // hands a buffer to a new thread. The events of earlier owners stay in the ring under their own tid and name;
+        // owners whose events have all been overwritten, or who recorded none, are forgotten
+        void take_over(ThreadBuffer& buffer, size_t tid){
+            const uint64_t written = buffer.written.load(std::memory_order_relaxed);
+            const uint64_t oldest_kept = written - std::min<uint64_t>(written, buffer.events.size());
+
+            std::vector<BufferOwner>& owners = buffer.owners;
+            if (!owners.empty() && owners.back().first == written) owners.pop_back();
+            size_t gone = 0;
+            while (gone < owners.size() && (gone + 1 < owners.size() ? owners[gone + 1].first : written) <= oldest_kept) gone++;
+            owners.erase(owners.begin(), owners.begin() + gone);
+
+            owners.push_back(BufferOwner{tid, "", written});
+        }
+
+        ThreadBuffer& current_buffer(){
+            if (!owner.buffer){
+                TraceRegistry& traces = registry();
+                std::lock_guard<std::mutex> lock(traces.mutex);
+
+                auto free = std::find_if(traces.buffers.begin(), traces.buffers.end(),
+                    [](const std::unique_ptr<ThreadBuffer>& buffer) { return !buffer->in_use; });
+                if (free == traces.buffers.end()){
+                    traces.buffers.push_back(std::make_unique<ThreadBuffer>());
+                    free = traces.buffers.end() - 1;
+                }
+
+                owner.buffer = free->get();
+                owner.buffer->in_use = true;
+                take_over(*owner.buffer, traces.next_tid++);
+            }
+            return *owner.buffer;
+        }
+
+        uint64_t steady_now_ns(){
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    void start_trace(size_t events_per_thread){
+        if (events_per_thread == 0) throw std::invalid_argument("A trace needs room for at least one event per thread");
+
+        TraceRegistry& traces = registry();
+        std::lock_guard<std::mutex> lock(traces.mutex);
+        traces.events_per_thread = events_per_thread;
+        for (std::unique_ptr<ThreadBuffer>& buffer : traces.buffers){
+            buffer->written.store(0, std::memory_order_relaxed);
+            // only the current owner carries over, a finished thread has nothing left in the new trace
+            if (!buffer->in_use) buffer->owners.clear();
+            else buffer->owners.erase(buffer->owners.begin(), buffer->owners.end() - 1);
+            if (!buffer->owners.empty()) buffer->owners.back().first = 0;
+        }
+        traces.origin_ns = steady_now_ns();
+        trace_recording.store(true, std::memory_order_release);
+    }
+
+    void stop_trace(){
+        trace_recording.store(false, std::memory_order_release);
+    }
+
+    void set_trace_thread_name(const std::string& name){
+        ThreadBuffer& buffer = current_buffer();
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        buffer.owners.back().name = name;
+    }
+
+    void record_trace_event(const TraceEvent& event){
+        ThreadBuffer& buffer = current_buffer();
+        if (buffer.events.empty()){
+            TraceRegistry& traces = registry();
+            std::lock_guard<std::mutex> lock(traces.mutex);
+            buffer.events.resize(traces.events_per_thread);
+        }
+
+        // only this thread writes its buffer; the release store publishes the event to write_chrome_trace
+        const uint64_t written = buffer.written.load(std::memory_order_relaxed);
+        buffer.events[written % buffer.events.size()] = event;
+        buffer.written.store(written + 1, std::memory_order_release);
+    }
+
+    void write_chrome_trace(std::ostream& out){
+        TraceRegistry& traces = registry();
+        std::lock_guard<std::mutex> lock(traces.mutex);
+
+        out << "{\"traceEvents\": [\n";
+        out << R"({"name": "process_name", "ph": "M", "pid": 1, "tid": 0, "args": {"name": "NeuralNetwork"}})";
+
+        uint64_t dropped = 0;
+        for (const std::unique_ptr<ThreadBuffer>& buffer : traces.buffers){
+            const uint64_t written = buffer->written.load(std::memory_order_acquire);
+            const uint64_t kept = std::min<uint64_t>(written, buffer->events.size());
+            dropped += written - kept;
+
+            const std::vector<BufferOwner>& owners = buffer->owners;
+            for (size_t o = 0; o < owners.size(); o++){
+                const BufferOwner& thread = owners[o];
+                const std::string name = thread.name.empty() ? std::format("thread {}", thread.tid) : thread.name;
+                out << std::format(",\n{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": {}, \"args\": {{\"name\": \"{}\"}}}}",
+                    thread.tid, name);
+
+                // oldest first; timestamps and durations are in microseconds
+                const uint64_t end = o + 1 < owners.size() ? owners[o + 1].first : written;
+                for (uint64_t i = std::max(thread.first, written - kept); i < end; i++){
+                    const TraceEvent& event = buffer->events[i % buffer->events.size()];
+                    out << std::format(",\n{{\"name\": \"{}\", \"cat\": \"{}\", \"ph\": \"X\", \"pid\": 1, \"tid\": {}, \"ts\": {:.3f}, \"dur\": {:.3f}",
+                        event.name, event.category, thread.tid, (double(event.start_ns) - double(traces.origin_ns)) / 1000.0,
+                        event.duration_ns / 1000.0);
+                    if (event.index >= 0) out << std::format(", \"args\": {{\"index\": {}}}", event.index);
+                    out << "}";
+                }
+            }
+        }
+
+        out << std::format("\n],\n\"displayTimeUnit\": \"ms\",\n\"otherData\": {{\"dropped_events\": {}}}}}\n", dropped);
+    }
+
+    void write_chrome_trace(const std::string& path){
+        std::ofstream out(path, std::ios::trunc);
+        if (!out.is_open()) throw std::runtime_error(std::format("Could not open trace file for writing: {}", path));
+
+        write_chrome_trace(out);
+
+        if (!out) throw std::runtime_error(std::format("Could not write trace file: {}", path));
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+namespace diagnostics{
+
+    // Trace spans are compiled in together with the telemetry (-DNN_TELEMETRY). Without it TraceSpan is empty
+    #ifdef NN_TELEMETRY
+    inline constexpr bool trace_compiled = true;
+    #else
+    inline constexpr bool trace_compiled = false;
+    #endif
+
+    /// @brief A finished span. name and category must outlive the trace - string literals
+    struct TraceEvent{
+        const char* name;
+        const char* category;
+        int64_t index;          // layer, chunk or epoch number shown as args.index, -1 for none
+        uint64_t start_ns;      // steady_clock time
+        uint64_t duration_ns;
+    };
+
+    // set by start_trace() and stop_trace(), read by every span
+    extern std::atomic<bool> trace_recording;
+
+    /// @brief Whether spans are being recorded
+    inline bool trace_enabled(){
+        return trace_compiled && trace_recording.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Clears the recorded spans and starts recording. Every thread records into its own ring buffer of
+    /// events_per_thread events, allocated on its first span; when it is full the oldest events are overwritten.
+    /// Buffers allocated by an earlier trace keep their size. Call it while no other thread is inside a span
+    void start_trace(size_t events_per_thread = 1 << 16);
+
+    /// @brief Stops recording; the recorded spans are kept until the next start_trace()
+    void stop_trace();
+
+    /// @brief Names the calling thread in the trace viewer. Threads without a name show up as "thread <n>"
+    void set_trace_thread_name(const std::string& name);
+
+    /// @brief Appends a span to the calling thread's ring buffer. Lock-free, except for the first span of a thread
+    void record_trace_event(const TraceEvent& event);
+
+    /// @brief Writes the recorded spans in the Chrome trace event format, loadable by chrome://tracing and Perfetto.
+    /// Spans that other threads record while this runs may be torn, so stop the trace first
+    void write_chrome_trace(std::ostream& out);
+    void write_chrome_trace(const std::string& path);
+
+    /// @brief Records the time between construction and destruction as a span of the calling thread,
+    /// when a trace is running at construction
+    class TraceSpan{
+        private:
+            const char* name;
+            const char* category;
+            int64_t index;
+            uint64_t start_ns = 0;
+            bool active;
+
+            static uint64_t now_ns(){
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+        public:
+            TraceSpan(const char* category, const char* name, int64_t index = -1)
+                : name(name), category(category), index(index), active(trace_enabled()) {
+                if (active) start_ns = now_ns();
+            }
+
+            ~TraceSpan(){
+                if (active) record_trace_event(TraceEvent{name, category, index, start_ns, now_ns() - start_ns});
+            }
+
+            TraceSpan(const TraceSpan&) = delete;
+            TraceSpan& operator=(const TraceSpan&) = delete;
+    };
+}
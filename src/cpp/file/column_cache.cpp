@@ -0,0 +1,163 @@
+#include "column_cache.h"
+#include "../diagnostics/trace.h"
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <format>
+
+namespace file_handling {
+
+    namespace fs = std::filesystem;
+
+    static uint64_t align_column_offset(uint64_t offset) {
+        return (offset + column_alignment - 1) / column_alignment * column_alignment;
+    }
+
+    // Paths are UTF-8 like the ones FileReader accepts, so non-ASCII paths also work on Windows
+    static fs::path utf8_path(const std::string& path) {
+        return fs::path(std::u8string(path.begin(), path.end()));
+    }
+
+    static int64_t source_mtime_of(const std::string& source_path) {
+        return static_cast<int64_t>(fs::last_write_time(utf8_path(source_path)).time_since_epoch().count());
+    }
+
+    std::string column_cache_path(const std::string& source_path) {
+        return source_path + ".nncache";
+    }
+
+    void write_column_cache(const std::vector<neural_network::TrainingSample>& samples, const std::string& source_path,
+        const std::string& cache_path) {
+        if (samples.empty()) throw std::invalid_argument("Cannot cache an empty data set");
+
+        write_column_cache(neural_network::Dataset::from_samples(samples), source_path, cache_path);
+    }
+
+    void write_column_cache(const neural_network::Dataset& data, const std::string& source_path, const std::string& cache_path) {
+        diagnostics::TraceSpan span("io", "write_column_cache");
+        const size_t row_count = data.get_row_count();
+        const size_t feature_count = data.get_input_count();
+        const size_t target_count = data.get_output_count();
+        const double* features = data.get_features().get_data();
+        const double* targets = data.get_targets().get_data();
+
+        ColumnCacheHeader header{};
+        std::memcpy(header.magic, column_cache_magic, sizeof(column_cache_magic));
+        header.version = column_cache_version;
+        header.header_size = sizeof(ColumnCacheHeader);
+        header.row_count = row_count;
+        header.feature_count = static_cast<uint32_t>(feature_count);
+        header.target_count = static_cast<uint32_t>(target_count);
+        header.source_size = fs::file_size(utf8_path(source_path));
+        header.source_mtime = source_mtime_of(source_path);
+        header.columns_offset = align_column_offset(sizeof(ColumnCacheHeader));
+        header.column_stride = align_column_offset(row_count * sizeof(double));
+        header.file_size = header.columns_offset + (feature_count + target_count) * header.column_stride;
+
+        const fs::path temp_path = utf8_path(cache_path + ".tmp");
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) throw std::runtime_error(std::format("Could not open cache file for writing: {}.tmp", cache_path));
+
+        // transpose one column at a time: rows -> column buffer padded to the stride
+        std::vector<char> padding(header.columns_offset - sizeof(ColumnCacheHeader), 0);
+        std::vector<double> column(header.column_stride / sizeof(double), 0.0);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+
+        for (size_t c = 0; file && c < feature_count + target_count; ++c) {
+            for (size_t r = 0; r < row_count; ++r) {
+                column[r] = c < feature_count ? features[r * feature_count + c] : targets[r * target_count + c - feature_count];
+            }
+            file.write(reinterpret_cast<const char*>(column.data()), static_cast<std::streamsize>(column.size() * sizeof(double)));
+        }
+
+        file.close();
+        if (!file) {
+            std::error_code ignored;
+            fs::remove(temp_path, ignored);
+            throw std::runtime_error(std::format("Could not write cache file: {}.tmp", cache_path));
+        }
+
+        fs::rename(temp_path, utf8_path(cache_path));
+    }
+
+    ColumnarDataset::ColumnarDataset(const std::string& cache_path)
+        : mapping(std::make_shared<MappedFile>(cache_path)) {
+        if (mapping->get_size() < sizeof(ColumnCacheHeader)) throw std::runtime_error(std::format("Not a column cache: {}", cache_path));
+        std::memcpy(&header, mapping->get_data(), sizeof(header));
+
+        if (std::memcmp(header.magic, column_cache_magic, sizeof(column_cache_magic)) != 0) {
+            throw std::runtime_error(std::format("Not a column cache: {}", cache_path));
+        }
+        if (header.version != column_cache_version) {
+            throw std::runtime_error(std::format("Unsupported column cache version {} in {}, expected {}",
+                header.version, cache_path, column_cache_version));
+        }
+
+        const uint64_t column_count = uint64_t(header.feature_count) + header.target_count;
+        const bool consistent = header.header_size == sizeof(ColumnCacheHeader)
+            && header.file_size == mapping->get_size()
+            && header.columns_offset % column_alignment == 0
+            && header.column_stride % column_alignment == 0
+            && header.row_count <= header.column_stride / sizeof(double)
+            && header.columns_offset <= header.file_size
+            && (header.column_stride == 0 || column_count <= (header.file_size - header.columns_offset) / header.column_stride);
+        if (!consistent) throw std::runtime_error(std::format("Corrupt column cache {}: inconsistent header", cache_path));
+    }
+
+    bool ColumnarDataset::matches_source(const std::string& source_path) const {
+        std::error_code error;
+        uint64_t size = fs::file_size(utf8_path(source_path), error);
+        if (error) return false;
+        return size == header.source_size && source_mtime_of(source_path) == header.source_mtime;
+    }
+
+    const double* ColumnarDataset::feature_column(size_t index) const {
+        if (index >= header.feature_count) {
+            throw std::out_of_range(std::format("Feature column {} out of range, the cache has {}", index, header.feature_count));
+        }
+        return reinterpret_cast<const double*>(mapping->get_data() + header.columns_offset + index * header.column_stride);
+    }
+
+    const double* ColumnarDataset::target_column(size_t index) const {
+        if (index >= header.target_count) {
+            throw std::out_of_range(std::format("Target column {} out of range, the cache has {}", index, header.target_count));
+        }
+        return reinterpret_cast<const double*>(mapping->get_data() + header.columns_offset
+            + (header.feature_count + index) * header.column_stride);
+    }
+
+    neural_network::Dataset ColumnarDataset::to_dataset(const std::vector<size_t>& feature_columns) const {
+        diagnostics::TraceSpan span("io", "column_cache_to_dataset");
+        std::vector<const double*> features;
+        if (feature_columns.empty()) {
+            for (size_t c = 0; c < header.feature_count; ++c) features.push_back(feature_column(c));
+        }
+        else {
+            for (size_t c : feature_columns) features.push_back(feature_column(c));
+        }
+
+        std::vector<const double*> targets;
+        for (size_t c = 0; c < header.target_count; ++c) targets.push_back(target_column(c));
+
+        // columns -> rows, one column at a time so the source is read sequentially
+        neural_network::Dataset data(header.row_count, features.size(), targets.size());
+        double* inputs = data.get_features().get_data();
+        double* outputs = data.get_targets().get_data();
+
+        for (size_t c = 0; c < features.size(); ++c) {
+            for (size_t r = 0; r < header.row_count; ++r) inputs[r * features.size() + c] = features[c][r];
+        }
+        for (size_t c = 0; c < targets.size(); ++c) {
+            for (size_t r = 0; r < header.row_count; ++r) outputs[r * targets.size() + c] = targets[c][r];
+        }
+        return data;
+    }
+
+    std::vector<neural_network::TrainingSample> ColumnarDataset::to_samples(const std::vector<size_t>& feature_columns) const {
+        return to_dataset(feature_columns).to_samples();
+    }
+
+} // namespace file_handling
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+#include "mapped_file.h"
+#include "../neural_network/neural_network.h"
+
+namespace file_handling {
+
+    // Column cache layout, all fields little-endian:
+    //   ColumnCacheHeader                              at offset 0
+    //   feature_count feature columns, then target_count target columns, starting at columns_offset.
+    //   Every column holds row_count doubles and starts column_stride bytes after the previous one,
+    //   a multiple of column_alignment, so the mapped columns can be used in place.
+    // source_size and source_mtime record the text file the cache was built from; a cache that does not match
+    // the current source file is stale and gets rebuilt.
+
+    static_assert(std::endian::native == std::endian::little, "Column caches are little-endian and mapped as-is");
+
+    constexpr char column_cache_magic[8] = {'N', 'N', 'C', 'O', 'L', 'S', '\0', '\0'};
+    constexpr uint32_t column_cache_version = 1;
+    constexpr size_t column_alignment = 64;
+
+    struct ColumnCacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t row_count;
+        uint32_t feature_count;
+        uint32_t target_count;
+        uint64_t source_size;
+        int64_t source_mtime;
+        uint64_t columns_offset;
+        uint64_t column_stride;
+        uint64_t file_size;
+    };
+
+    static_assert(sizeof(ColumnCacheHeader) == 72, "Column cache header must not contain padding");
+
+    /// @brief The cache file that belongs to a text training file: the same path with ".nncache" appended
+    std::string column_cache_path(const std::string& source_path);
+
+    /// @brief Writes a data set as a column cache for source_path. The cache is written to a temporary file and renamed
+    /// into place, so readers never map a half-written cache
+    void write_column_cache(const neural_network::Dataset& data, const std::string& source_path, const std::string& cache_path);
+
+    /// @brief Like above; all samples must have the same number of inputs and outputs
+    void write_column_cache(const std::vector<neural_network::TrainingSample>& samples, const std::string& source_path,
+        const std::string& cache_path);
+
+    /// @brief A memory mapped column cache. Columns are only paged in when they are read,
+    /// so loading a subset of the columns only reads that part of the file
+    class ColumnarDataset {
+    private:
+        std::shared_ptr<MappedFile> mapping;
+        ColumnCacheHeader header;
+
+    public:
+        /// @brief Maps a cache file and validates its layout
+        explicit ColumnarDataset(const std::string& cache_path);
+
+        /// @brief True when the cache was built from the source file as it is now
+        bool matches_source(const std::string& source_path) const;
+
+        size_t get_row_count() const { return header.row_count; }
+        size_t get_feature_count() const { return header.feature_count; }
+        size_t get_target_count() const { return header.target_count; }
+
+        /// @brief The row_count values of a feature or target column
+        const double* feature_column(size_t index) const;
+        const double* target_column(size_t index) const;
+
+        /// @brief Builds a data set from the given feature columns (all of them when empty) and every target column
+        neural_network::Dataset to_dataset(const std::vector<size_t>& feature_columns = {}) const;
+
+        /// @brief Like to_dataset, as one TrainingSample per row
+        std::vector<neural_network::TrainingSample> to_samples(const std::vector<size_t>& feature_columns = {}) const;
+    };
+
+} // namespace file_handling
@@ -0,0 +1,97 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#include <format>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace file_handling {
+
+    #ifdef _WIN32
+
+    MappedFile::MappedFile(const std::string& path) {
+        // the path is UTF-8, like the ones FileReader accepts
+        std::wstring wide_path = std::filesystem::path(std::u8string(path.begin(), path.end())).wstring();
+
+        HANDLE file = CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error(std::format("Could not open file: {} (error {})", path, GetLastError()));
+        }
+        file_handle = file;
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            unmap();
+            throw std::runtime_error(std::format("Could not map empty or unreadable file: {}", path));
+        }
+        size = static_cast<size_t>(file_size.QuadPart);
+
+        mapping_handle = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        if (mapping_handle == nullptr) {
+            unmap();
+            throw std::runtime_error(std::format("Could not map file: {} (error {})", path, GetLastError()));
+        }
+
+        data = static_cast<std::byte*>(MapViewOfFile(mapping_handle, FILE_MAP_COPY, 0, 0, 0));
+        if (data == nullptr) {
+            unmap();
+            throw std::runtime_error(std::format("Could not map file: {} (error {})", path, GetLastError()));
+        }
+    }
+
+    void MappedFile::unmap() {
+        if (data != nullptr) UnmapViewOfFile(data);
+        if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+        if (file_handle != nullptr) CloseHandle(file_handle);
+        data = nullptr;
+        mapping_handle = nullptr;
+        file_handle = nullptr;
+    }
+
+    #else
+
+    MappedFile::MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error(std::format("Could not open file: {} ({})", path, std::strerror(errno)));
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            close(fd);
+            throw std::runtime_error(std::format("Could not map empty or unreadable file: {}", path));
+        }
+        size = static_cast<size_t>(info.st_size);
+
+        void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error(std::format("Could not map file: {} ({})", path, std::strerror(errno)));
+        }
+        data = static_cast<std::byte*>(mapped);
+    }
+
+    void MappedFile::unmap() {
+        if (data != nullptr) munmap(data, size);
+        data = nullptr;
+    }
+
+    #endif
+
+    MappedFile::~MappedFile() {
+        unmap();
+    }
+
+} // namespace file_handling
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace file_handling {
+
+    /// @brief Maps a whole file into memory for as long as the object lives.
+    /// The mapping is private copy-on-write: pages stay shared with the page cache (and every other process
+    /// mapping the same file) until they are written to, and writes never reach the file
+    class MappedFile {
+    private:
+        std::byte* data = nullptr;
+        size_t size = 0;
+
+        #ifdef _WIN32
+        void* file_handle = nullptr;
+        void* mapping_handle = nullptr;
+        #endif
+
+        void unmap();
+
+    public:
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        std::byte* get_data() { return data; }
+        const std::byte* get_data() const { return data; }
+        size_t get_size() const { return size; }
+    };
+
+} // namespace file_handling
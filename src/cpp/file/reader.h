@@ -10,6 +10,8 @@
 #include <locale>
 #include <codecvt>
 #include "../neural_network/neural_network.h"
+#include "column_cache.h"
+#include "text_parser.h"
 
 namespace file_handling {
 
@@ -21,23 +23,18 @@ namespace file_handling {
     private:
         fs::path fpath;
         
-        // Helper function to split a string by whitespace
-        std::vector<std::string> split(const std::string& s) {
-            std::vector<std::string> tokens;
-            std::string token;
-            std::istringstream tokenStream(s);
-            while (tokenStream >> token) {
-                tokens.push_back(token);
-            }
-            return tokens;
-        }
-
         // Convert UTF-8 string to wstring (for Windows paths)
         std::wstring utf8_to_wstring(const std::string& str) {
             std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
             return converter.from_bytes(str);
         }
 
+        // The path as UTF-8, the encoding the file_handling functions take
+        std::string utf8_path() const {
+            std::u8string path = fpath.u8string();
+            return std::string(path.begin(), path.end());
+        }
+
     public:
         // Constructor that handles both ANSI and Unicode paths
         FileReader(const std::string& path) {
@@ -54,51 +51,77 @@ namespace file_handling {
             }
         }
 
+        /// @brief Reads the training data file straight into a Dataset.
+        /// All columns except the last one are input features, the last one is the expected output
+        neural_network::Dataset readDataset() {
+            // Skip the header line (x1 x2 x3 x4 y)
+            ParsedTable report;
+            neural_network::Dataset data = parse_dataset_file(utf8_path(), 1, report, 0, true);
+
+            for (const MalformedLine& line : report.malformed) {
+                PRINT("Error parsing line " + std::to_string(line.line_number) + " (" + line.reason + "): " + line.text)
+            }
+            if (report.malformed_count > report.malformed.size()) {
+                PRINT(std::to_string(report.malformed_count - report.malformed.size()) + " more malformed lines skipped")
+            }
+
+            return data;
+        }
+
         /// @brief Reads the training data file and parses it into TrainingSample objects
         /// @return Vector of TrainingSample objects
         std::vector<neural_network::TrainingSample> readTrainingData() {
-            std::ifstream file(fpath);
-            if (!file.is_open()) {
-                // throw std::runtime_error("Could not open file: " + fpath.string());
-                PRINT("Could not open file: " + fpath.string())
-            }
-
-            std::vector<neural_network::TrainingSample> samples;
-            std::string line;
-            
-            // Skip the header line (x1 x2 x3 x4 y)
-            std::getline(file, line);
-
-            while (std::getline(file, line)) {
-                if (line.empty()) continue;
-
-                auto tokens = split(line);
-                if (tokens.size() < 2) continue;  // Skip malformed lines
-
-                neural_network::TrainingSample sample;
-                
-                // All tokens except the last one are input features
-                for (size_t i = 0; i < tokens.size() - 1; ++i) {
-                    try {
-                        sample.input_data.push_back(std::stod(tokens[i]));
-                    } catch (const std::exception& e) {
-                        // throw std::runtime_error("Error parsing number in line: " + line);
-                        PRINT("Error parsing number in line: " + line)
-                    }
-                }
+            return readDataset().to_samples();
+        }
 
-                // Last token is the expected output
+        /// @brief Like readDataset, but keeps a binary column cache next to the file (see column_cache.h).
+        /// The first run parses the text and writes the cache, later runs map the cache instead of parsing.
+        /// A cache that no longer matches the text file is rebuilt
+        /// @param feature_columns Input columns to load, all of them when empty. Unused columns are never read from disk
+        neural_network::Dataset readDatasetCached(const std::vector<size_t>& feature_columns = {}) {
+            std::u8string utf8_source = fpath.u8string();
+            std::string source(utf8_source.begin(), utf8_source.end());
+            std::string cache = column_cache_path(source);
+
+            fs::path cache_file = fpath;
+            cache_file += ".nncache";
+            if (fs::exists(cache_file)) {
                 try {
-                    sample.expected_output.push_back(std::stod(tokens.back()));
-                } catch (const std::exception& e) {
-                    // throw std::runtime_error("Error parsing expected output in line: " + line);
-                    PRINT("Error parsing expected output in line: " + line)
+                    ColumnarDataset cached(cache);
+                    if (cached.matches_source(source)) return cached.to_dataset(feature_columns);
+                }
+                catch (const std::exception& e) {
+                    PRINT("Ignoring unreadable cache " + cache + ": " + e.what())
                 }
+            }
 
-                samples.push_back(sample);
+            neural_network::Dataset data = readDataset();
+            try {
+                write_column_cache(data, source, cache);
             }
+            catch (const std::exception& e) {
+                PRINT("Could not write cache " + cache + ": " + e.what())
+            }
+
+            if (feature_columns.empty()) return data;
+
+            const size_t input_count = data.get_input_count();
+            neural_network::Dataset selected(data.get_row_count(), feature_columns.size(), data.get_output_count());
+            const double* inputs = data.get_features().get_data();
+            double* selected_inputs = selected.get_features().get_data();
+            for (size_t r = 0; r < data.get_row_count(); ++r) {
+                for (size_t c = 0; c < feature_columns.size(); ++c) {
+                    if (feature_columns[c] >= input_count) throw std::out_of_range("Feature column " + std::to_string(feature_columns[c]) + " out of range");
+                    selected_inputs[r * feature_columns.size() + c] = inputs[r * input_count + feature_columns[c]];
+                }
+            }
+            std::copy_n(data.get_targets().get_data(), data.get_row_count() * data.get_output_count(), selected.get_targets().get_data());
+            return selected;
+        }
 
-            return samples;
+        /// @brief readDatasetCached as one TrainingSample per row
+        std::vector<neural_network::TrainingSample> readTrainingDataCached(const std::vector<size_t>& feature_columns = {}) {
+            return readDatasetCached(feature_columns).to_samples();
         }
 
         /// @brief Checks if the file exists and is readable
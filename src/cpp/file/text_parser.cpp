@@ -0,0 +1,246 @@
+#include "text_parser.h"
+#include "mapped_file.h"
+#include "../parallel/thread_pool.h"
+#include "../diagnostics/trace.h"
+#include <charconv>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <format>
+#include <filesystem>
+#include <functional>
+#include <optional>
+
+namespace file_handling {
+
+    // chunks smaller than this are not worth a thread
+    static constexpr size_t min_chunk_bytes = 1 << 20;
+
+    static bool is_blank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static const char* find_line_end(const char* begin, const char* end) {
+        const void* newline = std::memchr(begin, '\n', end - begin);
+        return newline != nullptr ? static_cast<const char*>(newline) : end;
+    }
+
+    // The start of the line after the one ending at line_end
+    static const char* next_line(const char* line_end, const char* end) {
+        return line_end == end ? end : line_end + 1;
+    }
+
+    // The values and bad lines of one chunk; line numbers are relative to the chunk until the chunks are merged
+    struct ChunkResult {
+        std::vector<double> values;
+        std::vector<MalformedLine> malformed;
+        size_t malformed_count = 0;
+        size_t line_count = 0;
+    };
+
+    // Appends the numbers of one line to values. Returns the number of columns,
+    // or 0 for a line that is malformed (reason set) or empty (reason left empty)
+    static size_t parse_line(const char* begin, const char* end, std::vector<double>& values, const char*& reason) {
+        const size_t start_size = values.size();
+        size_t columns = 0;
+        const char* p = begin;
+
+        while (true) {
+            while (p < end && is_blank(*p)) ++p;
+            if (p == end) break;
+
+            const char* token_end = p;
+            while (token_end < end && !is_blank(*token_end)) ++token_end;
+
+            // from_chars does not take the leading '+' that stod accepted
+            const char* number_begin = (*p == '+' && token_end - p > 1) ? p + 1 : p;
+
+            double value;
+            auto [parsed_end, error] = std::from_chars(number_begin, token_end, value);
+            if (error != std::errc() || parsed_end != token_end) {
+                values.resize(start_size);
+                reason = "not a number";
+                return 0;
+            }
+
+            values.push_back(value);
+            ++columns;
+            p = token_end;
+        }
+
+        if (columns == 1) {
+            values.resize(start_size);
+            reason = "fewer than 2 columns";
+            return 0;
+        }
+        return columns;
+    }
+
+    static void parse_chunk(const char* begin, const char* end, size_t column_count, ChunkResult& result) {
+        result.values.reserve(result.values.size() + (end - begin) / 8);
+
+        for (const char* line = begin; line < end; ) {
+            const char* line_end = find_line_end(line, end);
+            result.line_count++;
+
+            const char* reason = nullptr;
+            size_t columns = parse_line(line, line_end, result.values, reason);
+            if (columns != 0 && columns != column_count) {
+                result.values.resize(result.values.size() - columns);
+                reason = "wrong number of columns";
+            }
+
+            if (reason != nullptr) {
+                if (result.malformed.size() < max_reported_malformed) {
+                    const char* text_end = line_end;
+                    while (text_end > line && text_end[-1] == '\r') --text_end;
+                    result.malformed.push_back({result.line_count, std::string(line, text_end), std::string(reason)});
+                }
+                result.malformed_count++;
+            }
+
+            line = next_line(line_end, end);
+        }
+    }
+
+    size_t parse_table_lines(const char* begin, const char* end, size_t first_line_number, ParsedTable& table) {
+        if (table.column_count == 0) {
+            for (const char* line = begin; line < end && table.column_count == 0; ) {
+                const char* line_end = find_line_end(line, end);
+                std::vector<double> probe;
+                const char* reason = nullptr;
+                table.column_count = parse_line(line, line_end, probe, reason);
+                line = next_line(line_end, end);
+            }
+            if (table.column_count == 0) return 0;
+        }
+
+        ChunkResult chunk;
+        std::swap(chunk.values, table.values);
+        parse_chunk(begin, end, table.column_count, chunk);
+        std::swap(chunk.values, table.values);
+
+        table.row_count = table.values.size() / table.column_count;
+        for (MalformedLine& line : chunk.malformed) {
+            if (table.malformed.size() == max_reported_malformed) break;
+            line.line_number += first_line_number - 1;
+            table.malformed.push_back(std::move(line));
+        }
+        table.malformed_count += chunk.malformed_count;
+        return chunk.line_count;
+    }
+
+    // Parses the file in parallel chunks. table gets the column and row counts and the malformed lines, the values stay
+    // in the chunks: once the row count is known allocate(table) runs, then store(first_row, values) for every chunk in parallel
+    static void parse_file_chunks(const std::string& path, size_t threads, bool skip_header, ParsedTable& table,
+        const std::function<void(const ParsedTable&)>& allocate, const std::function<void(size_t, const std::vector<double>&)>& store) {
+        diagnostics::TraceSpan span("io", "parse_file");
+        // an empty file has nothing to map
+        if (std::filesystem::file_size(std::filesystem::path(std::u8string(path.begin(), path.end()))) == 0) return;
+
+        MappedFile file(path);
+        const char* begin = reinterpret_cast<const char*>(file.get_data());
+        const char* end = begin + file.get_size();
+
+        size_t header_lines = 0;
+        if (skip_header) {
+            begin = next_line(find_line_end(begin, end), end);
+            header_lines = 1;
+        }
+
+        // the first line with numbers decides the column count for every chunk
+        for (const char* line = begin; line < end && table.column_count == 0; ) {
+            const char* line_end = find_line_end(line, end);
+            std::vector<double> probe;
+            const char* reason = nullptr;
+            table.column_count = parse_line(line, line_end, probe, reason);
+            line = next_line(line_end, end);
+        }
+        if (table.column_count == 0) return;
+
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        const size_t bytes = end - begin;
+        const size_t chunk_count = std::max<size_t>(1, std::min(threads, bytes / min_chunk_bytes));
+
+        // chunk boundaries move forward to the next line start
+        std::vector<const char*> bounds(chunk_count + 1, end);
+        bounds[0] = begin;
+        for (size_t i = 1; i < chunk_count; ++i) {
+            const char* nominal = std::max(bounds[i - 1], begin + bytes / chunk_count * i);
+            bounds[i] = next_line(find_line_end(nominal, end), end);
+        }
+
+        std::vector<ChunkResult> chunks(chunk_count);
+        parallel::ThreadPool pool(chunk_count);
+        pool.run(chunk_count, [&](size_t i) {
+            diagnostics::TraceSpan chunk_span("io", "parse_chunk", i);
+            parse_chunk(bounds[i], bounds[i + 1], table.column_count, chunks[i]);
+        });
+
+        std::vector<size_t> row_offsets(chunk_count + 1, 0);
+        size_t line_offset = header_lines;
+        for (size_t i = 0; i < chunk_count; ++i) {
+            row_offsets[i + 1] = row_offsets[i] + chunks[i].values.size() / table.column_count;
+
+            for (MalformedLine& line : chunks[i].malformed) {
+                if (table.malformed.size() == max_reported_malformed) break;
+                line.line_number += line_offset;
+                table.malformed.push_back(std::move(line));
+            }
+            table.malformed_count += chunks[i].malformed_count;
+            line_offset += chunks[i].line_count;
+        }
+
+        table.row_count = row_offsets.back();
+        allocate(table);
+        pool.run(chunk_count, [&](size_t i) {
+            diagnostics::TraceSpan chunk_span("io", "store_chunk", i);
+            store(row_offsets[i], chunks[i].values);
+            std::vector<double>().swap(chunks[i].values);
+        });
+    }
+
+    ParsedTable parse_table_file(const std::string& path, size_t threads, bool skip_header) {
+        ParsedTable table;
+        parse_file_chunks(path, threads, skip_header, table,
+            [&](const ParsedTable&) {
+                table.values.resize(table.row_count * table.column_count);
+            },
+            [&](size_t first_row, const std::vector<double>& values) {
+                std::copy(values.begin(), values.end(), table.values.begin() + first_row * table.column_count);
+            });
+        return table;
+    }
+
+    neural_network::Dataset parse_dataset_file(const std::string& path, size_t output_count, ParsedTable& report,
+        size_t threads, bool skip_header) {
+        std::optional<neural_network::Dataset> data;
+        report = ParsedTable();
+
+        parse_file_chunks(path, threads, skip_header, report,
+            [&](const ParsedTable& table) {
+                if (table.column_count <= output_count) {
+                    throw std::runtime_error(std::format("{} has {} columns, needs more than the {} output columns",
+                        path, table.column_count, output_count));
+                }
+                data.emplace(table.row_count, table.column_count - output_count, output_count);
+            },
+            [&](size_t first_row, const std::vector<double>& values) {
+                // split every parsed row into its input and output part
+                const size_t inputs = data->get_input_count();
+                const size_t columns = inputs + output_count;
+                double* features = data->get_features().get_data() + first_row * inputs;
+                double* targets = data->get_targets().get_data() + first_row * output_count;
+
+                for (size_t r = 0; r < values.size() / columns; ++r) {
+                    const double* row = values.data() + r * columns;
+                    std::copy_n(row, inputs, features + r * inputs);
+                    std::copy_n(row + inputs, output_count, targets + r * output_count);
+                }
+            });
+
+        if (!data) throw std::runtime_error(std::format("{} contains no data rows", path));
+        return std::move(*data);
+    }
+
+} // namespace file_handling
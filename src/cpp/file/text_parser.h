@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "../neural_network/dataset.h"
+
+namespace file_handling {
+
+    /// @brief A line that could not be parsed, reported instead of silently dropped
+    struct MalformedLine {
+        size_t line_number;     // 1-based, the header is line 1
+        std::string text;
+        std::string reason;
+    };
+
+    /// @brief The numbers of a whitespace separated text file, row-major in one contiguous buffer
+    struct ParsedTable {
+        size_t column_count = 0;
+        size_t row_count = 0;
+        std::vector<double> values;
+
+        /// @brief The first max_reported_malformed bad lines in file order; malformed_count counts all of them
+        std::vector<MalformedLine> malformed;
+        size_t malformed_count = 0;
+    };
+
+    constexpr size_t max_reported_malformed = 100;
+
+    /// @brief Parses a whitespace separated table of numbers. The file is memory mapped and split into newline-aligned
+    /// chunks that are tokenized and converted with std::from_chars in parallel, straight into the value buffer.
+    /// The column count is taken from the first data line; lines with another number of columns or a token that is
+    /// not a number are reported as malformed and skipped, empty lines are skipped
+    /// @param threads Number of parsing threads, 0 uses every core
+    /// @param skip_header Skip the first line (column names)
+    ParsedTable parse_table_file(const std::string& path, size_t threads = 0, bool skip_header = true);
+
+    /// @brief Parses a training file like parse_table_file, but stores the rows straight into a Dataset:
+    /// the last output_count columns are the expected outputs, the others the inputs
+    /// @param report Receives the column and row counts and the malformed lines; its values stay empty
+    neural_network::Dataset parse_dataset_file(const std::string& path, size_t output_count, ParsedTable& report,
+        size_t threads = 0, bool skip_header = true);
+
+    /// @brief Parses the lines in [begin, end) single threaded and appends their numbers to table.values, for callers
+    /// that read a file piece by piece. The range must end at a line end. A table.column_count of 0 is taken from the
+    /// first data line. Malformed lines are added to table.malformed numbered from first_line_number
+    /// @return The number of lines in the range
+    size_t parse_table_lines(const char* begin, const char* end, size_t first_line_number, ParsedTable& table);
+
+} // namespace file_handling
@@ -0,0 +1,148 @@
+#include "text_stream.h"
+#include "../diagnostics/trace.h"
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <format>
+
+namespace file_handling {
+
+    TextFileStream::TextFileStream(const std::string& path, size_t output_count, size_t chunk_bytes, size_t depth)
+        : path(path), output_count(output_count), chunk_bytes(chunk_bytes), depth(depth) {
+        if (output_count == 0) throw std::invalid_argument("A training stream needs at least one output column");
+        if (chunk_bytes == 0 || depth == 0) throw std::invalid_argument("Chunk size and read-ahead depth must be >= 1");
+
+        // the column count comes from the first data line
+        std::ifstream file(std::filesystem::path(std::u8string(path.begin(), path.end())), std::ios::binary);
+        if (!file.is_open()) throw std::runtime_error(std::format("Could not open file: {}", path));
+
+        std::string line;
+        std::getline(file, line);
+        ParsedTable probe;
+        while (probe.column_count == 0 && std::getline(file, line)) {
+            parse_table_lines(line.data(), line.data() + line.size(), 2, probe);
+        }
+        if (probe.column_count <= output_count) {
+            throw std::runtime_error(std::format("{} has no rows with more than {} columns", path, output_count));
+        }
+        input_count = probe.column_count - output_count;
+
+        start();
+    }
+
+    TextFileStream::~TextFileStream() {
+        stop();
+    }
+
+    void TextFileStream::start() {
+        end_of_file = false;
+        stopping = false;
+        reader_error = nullptr;
+        malformed = ParsedTable();
+        reader = std::thread(&TextFileStream::read_ahead, this);
+    }
+
+    void TextFileStream::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        chunk_taken.notify_all();
+        if (reader.joinable()) reader.join();
+
+        // keep the buffers of the unread chunks for the next pass
+        for (std::vector<double>& chunk : ready) spare.push_back(std::move(chunk));
+        ready.clear();
+    }
+
+    void TextFileStream::rewind() {
+        stop();
+        start();
+    }
+
+    bool TextFileStream::next_chunk(std::vector<double>& rows) {
+        std::unique_lock<std::mutex> lock(mutex);
+        chunk_ready.wait(lock, [this] { return !ready.empty() || end_of_file || reader_error; });
+        if (reader_error) std::rethrow_exception(reader_error);
+        if (ready.empty()) return false;
+
+        // hand the caller's old buffer to the reader in exchange
+        std::vector<double> consumed = std::move(rows);
+        rows = std::move(ready.front());
+        ready.erase(ready.begin());
+        if (consumed.capacity() > 0) spare.push_back(std::move(consumed));
+        lock.unlock();
+        chunk_taken.notify_one();
+        return true;
+    }
+
+    void TextFileStream::read_ahead() {
+        diagnostics::set_trace_thread_name("text reader");
+        try {
+            std::ifstream file(std::filesystem::path(std::u8string(path.begin(), path.end())), std::ios::binary);
+            if (!file.is_open()) throw std::runtime_error(std::format("Could not open file: {}", path));
+
+            std::string header;
+            std::getline(file, header);
+            size_t line_number = 2;
+
+            // a block ends with a partial line, which is carried over to the front of the next block
+            std::vector<char> block;
+            size_t carried = 0;
+            ParsedTable table;
+            table.column_count = input_count + output_count;
+
+            while (true) {
+                block.resize(carried + chunk_bytes);
+                file.read(block.data() + carried, static_cast<std::streamsize>(chunk_bytes));
+                const size_t filled = carried + static_cast<size_t>(file.gcount());
+                const bool last = filled < carried + chunk_bytes;
+
+                size_t complete = filled;
+                if (!last) {
+                    while (complete > 0 && block[complete - 1] != '\n') --complete;
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    chunk_taken.wait(lock, [this] { return ready.size() < depth || stopping; });
+                    if (stopping) return;
+                    if (!spare.empty()) {
+                        table.values = std::move(spare.back());
+                        spare.pop_back();
+                    }
+                }
+
+                table.values.clear();
+                table.malformed.clear();
+                table.malformed_count = 0;
+                {
+                    diagnostics::TraceSpan span("io", "parse_block");
+                    line_number += parse_table_lines(block.data(), block.data() + complete, line_number, table);
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (MalformedLine& line : table.malformed) {
+                        if (malformed.malformed.size() < max_reported_malformed) malformed.malformed.push_back(std::move(line));
+                    }
+                    malformed.malformed_count += table.malformed_count;
+                    if (!table.values.empty()) ready.push_back(std::move(table.values));
+                    if (last) end_of_file = true;
+                }
+                chunk_ready.notify_one();
+                if (last) return;
+
+                // a line longer than a whole block keeps growing the carried part until its end shows up
+                carried = filled - complete;
+                std::copy(block.begin() + complete, block.begin() + filled, block.begin());
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            reader_error = std::current_exception();
+            chunk_ready.notify_one();
+        }
+    }
+
+} // namespace file_handling
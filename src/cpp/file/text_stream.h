@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "text_parser.h"
+#include "../neural_network/neural_network.h"
+
+namespace file_handling {
+
+    /// @brief Streams the rows of a whitespace separated training file without loading it: a read-ahead thread reads
+    /// fixed-size blocks, parses their complete lines and queues the parsed chunks while the trainer consumes earlier ones.
+    /// Memory is bounded by chunk_bytes times the read-ahead depth
+    class TextFileStream : public neural_network::SampleStream {
+    private:
+        std::string path;
+        size_t output_count;
+        size_t input_count = 0;
+        size_t chunk_bytes;
+        size_t depth;
+
+        // parsed chunks ready for the trainer, and emptied ones handed back for reuse
+        std::vector<std::vector<double>> ready;
+        std::vector<std::vector<double>> spare;
+        bool end_of_file = false;
+        bool stopping = false;
+
+        std::mutex mutex;
+        std::condition_variable chunk_ready;
+        std::condition_variable chunk_taken;
+
+        ParsedTable malformed;
+        std::exception_ptr reader_error;
+        std::thread reader;
+
+        void read_ahead();
+        void start();
+        void stop();
+
+    public:
+        /// @param output_count The number of trailing columns that are expected outputs
+        /// @param chunk_bytes Size of the blocks read from the file
+        /// @param depth Number of parsed chunks the reader may queue ahead of the trainer
+        explicit TextFileStream(const std::string& path, size_t output_count = 1, size_t chunk_bytes = 4 << 20, size_t depth = 2);
+        ~TextFileStream();
+
+        TextFileStream(const TextFileStream&) = delete;
+        TextFileStream& operator=(const TextFileStream&) = delete;
+
+        size_t get_input_count() const override { return input_count; }
+        size_t get_output_count() const override { return output_count; }
+
+        bool next_chunk(std::vector<double>& rows) override;
+        void rewind() override;
+
+        /// @brief The malformed lines of the pass that was read last (malformed / malformed_count)
+        const ParsedTable& get_malformed() const { return malformed; }
+    };
+
+} // namespace file_handling
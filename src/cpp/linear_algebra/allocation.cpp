@@ -0,0 +1,57 @@
+#include "allocation.h"
+#include <atomic>
+
+namespace lin_alg{
+
+// the thread's own totals need no synchronization, only the process-wide ones are atomic
+static thread_local AllocationCounts thread_counts;
+
+static std::atomic<uint64_t> total_allocations{0};
+static std::atomic<uint64_t> total_bytes{0};
+static std::atomic<uint64_t> live_bytes{0};
+static std::atomic<uint64_t> peak_live_bytes{0};
+
+AllocationCounts& AllocationCounts::operator+=(const AllocationCounts& other){
+    allocations += other.allocations;
+    bytes += other.bytes;
+    return *this;
+}
+
+AllocationCounts AllocationCounts::operator-(const AllocationCounts& other) const{
+    return AllocationCounts{allocations - other.allocations, bytes - other.bytes};
+}
+
+void record_allocation(size_t bytes){
+    thread_counts.allocations++;
+    thread_counts.bytes += bytes;
+
+    total_allocations.fetch_add(1, std::memory_order_relaxed);
+    total_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    const uint64_t live = live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    uint64_t peak = peak_live_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+void record_deallocation(size_t bytes){
+    live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+AllocationCounts thread_allocations(){
+    return thread_counts;
+}
+
+MemoryFootprint memory_footprint(){
+    return MemoryFootprint{
+        total_allocations.load(std::memory_order_relaxed),
+        total_bytes.load(std::memory_order_relaxed),
+        live_bytes.load(std::memory_order_relaxed),
+        peak_live_bytes.load(std::memory_order_relaxed)
+    };
+}
+
+void reset_peak_live_bytes(){
+    peak_live_bytes.store(live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+#include <type_traits>
+
+namespace lin_alg{
+
+// Allocation tracking is compiled in with -DNN_ALLOC_TRACKING (the NN_ALLOC_TRACKING CMake option, off by default:
+// every allocation then updates process-wide atomics that training threads contend on). Without it Matrix and Vector
+// store their elements with std::allocator and every count below stays 0
+#ifdef NN_ALLOC_TRACKING
+inline constexpr bool allocation_tracking = true;
+#else
+inline constexpr bool allocation_tracking = false;
+#endif
+
+/// @brief Matrix and Vector storage allocated by one thread, or by one section of its work
+struct AllocationCounts{
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+
+    AllocationCounts& operator+=(const AllocationCounts& other);
+    AllocationCounts operator-(const AllocationCounts& other) const;
+};
+
+/// @brief Matrix and Vector storage of the whole process
+struct MemoryFootprint{
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    uint64_t live_bytes = 0;
+    uint64_t peak_live_bytes = 0;   // since the start or the last reset_peak_live_bytes()
+};
+
+/// @brief Running totals of the calling thread; the difference of two calls counts the allocations in between
+AllocationCounts thread_allocations();
+
+MemoryFootprint memory_footprint();
+
+/// @brief Lowers the peak to the bytes live now, so the peak of the work that follows can be read
+void reset_peak_live_bytes();
+
+/// @brief Counters behind TrackingAllocator and Storage
+void record_allocation(size_t bytes);
+void record_deallocation(size_t bytes);
+
+/// @brief std::allocator that reports every allocation and deallocation to the counters above
+template <typename T>
+struct TrackingAllocator{
+    using value_type = T;
+
+    TrackingAllocator() = default;
+    template <typename U> TrackingAllocator(const TrackingAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n){
+        T* memory = std::allocator<T>().allocate(n);
+        record_allocation(n * sizeof(T));
+        return memory;
+    }
+
+    void deallocate(T* memory, size_t n) noexcept{
+        record_deallocation(n * sizeof(T));
+        std::allocator<T>().deallocate(memory, n);
+    }
+
+    template <typename U> bool operator==(const TrackingAllocator<U>&) const noexcept { return true; }
+};
+
+using StorageVector = std::conditional_t<allocation_tracking, std::vector<double, TrackingAllocator<double>>, std::vector<double>>;
+
+/// @brief The element storage of Matrix and Vector. Matrix and Vector hold it through a unique_ptr, so every one of them
+/// makes two allocations: this object, counted by its operator new, and the element buffer, counted by TrackingAllocator
+struct Storage : StorageVector{
+    using StorageVector::StorageVector;
+
+    static void* operator new(size_t bytes){
+        void* memory = ::operator new(bytes);
+        if constexpr (allocation_tracking) record_allocation(bytes);
+        return memory;
+    }
+
+    static void operator delete(void* memory, size_t bytes) noexcept{
+        if constexpr (allocation_tracking) record_deallocation(bytes);
+        ::operator delete(memory, bytes);
+    }
+};
+
+}
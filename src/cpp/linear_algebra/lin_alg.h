@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include "allocation.h"
 
 
 namespace lin_alg{
@@ -12,19 +13,38 @@ class Matrix;
 class Vector{
 private:
 size_t size;
-std::unique_ptr<std::vector<double>> data;
+// owned storage, empty for views
+std::unique_ptr<Storage> data;
+// the elements - either data's buffer or borrowed memory of a view
+double* values;
 
 void validate_index(size_t i) const;
 
+// a view over borrowed elements
+Vector(double* values, size_t size);
+
 public:
 Vector(size_t size);
 
 Vector(const Vector& other);
 
+Vector(Vector&& other) noexcept;
+
 Vector(const std::vector<double>& other);
 
+/// @brief Creates a vector over size elements it does not own, e.g. the weights of a memory mapped model.
+/// The memory must outlive the view. Copies of a view own their elements again
+static Vector view(double* values, size_t size);
+
+/// @brief True when the elements are borrowed instead of owned
+bool is_view() const;
+
 size_t get_size() const;
 
+/// @brief Raw access to the contiguous element storage
+double* get_data();
+const double* get_data() const;
+
 double& operator()(size_t i);
 
 const double operator()(size_t i) const;
@@ -33,6 +53,7 @@ Vector operator*(double scalar) const;  // NEW: Ensure it's const
 Vector operator*(const Matrix& other) const;
 Vector operator+(const Vector& other) const;
 Vector& operator=(const Vector& other); // Copy assignment
+Vector& operator=(Vector&& other) noexcept;
 Vector& operator-=(const Vector& other); // NEW: Vector -= Vector
 Vector& operator+=(const Vector& other);
 
@@ -52,22 +73,41 @@ private:
 size_t rows;
 size_t cols;
 
-std::unique_ptr<std::vector<double>> data;
+// owned storage, empty for views
+std::unique_ptr<Storage> data;
+// the elements - either data's buffer or borrowed memory of a view
+double* values;
 
 void validate_indices(size_t r, size_t c) const;
 
+// a view over borrowed elements
+Matrix(double* values, size_t rows, size_t cols);
+
 public:
 
 Matrix(size_t rows, size_t cols);
 
 Matrix(const Matrix& other);
 
+Matrix(Matrix&& other) noexcept;
+
+/// @brief Creates a rows x cols row-major matrix over elements it does not own, e.g. the weights of a memory mapped model.
+/// The memory must outlive the view. Copies of a view own their elements again
+static Matrix view(double* values, size_t rows, size_t cols);
+
+/// @brief True when the elements are borrowed instead of owned
+bool is_view() const;
+
 Matrix transpose() const;
 
 size_t get_rows_count() const;
 
 size_t get_cols_count() const;
 
+/// @brief Raw access to the contiguous, row-major element storage
+double* get_data();
+const double* get_data() const;
+
 double operator()(size_t r, size_t c) const;
 
 double& operator()(size_t r, size_t c);
@@ -76,6 +116,7 @@ Matrix operator*(const double& scalar) const; // NEW: Matrix * scalar
 Matrix operator*(const Matrix& other) const;   // Matrix-Matrix multiplication
 Vector operator*(const Vector& other) const;   // Matrix-Vector multiplication
 Matrix& operator=(const Matrix& other);  // Copy assignment
+Matrix& operator=(Matrix&& other) noexcept;
 Matrix& operator-=(const Matrix& other); // NEW: Matrix -= Matrix
 Matrix& operator+=(const Matrix& other);
 Matrix operator-(const Matrix& other) const;
@@ -95,4 +136,17 @@ Matrix elementwise_add(const Vector& other) const;
 void print_matrix() const;
 };
 
+/// @brief Matrix-Matrix multiplication into a preallocated result: out = a * b.
+/// Cache blocked over the shared dimension, rows of b are streamed contiguously
+void gemm(const Matrix& a, const Matrix& b, Matrix& out);
+
+/// @brief Writes the transpose of a into a preallocated cols x rows result
+void transpose_into(const Matrix& a, Matrix& out);
+
+/// @brief Adds row to every row of m in place, the bias add of a layer
+void add_row_vector(Matrix& m, const Vector& row);
+
+/// @brief Writes the sum of every column of a into a preallocated vector, collapse_rows without the allocation
+void column_sums(const Matrix& a, Vector& out);
+
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <format>
 #include <functional>
+#include <algorithm>
 
 namespace lin_alg {
 
@@ -12,38 +13,168 @@ Matrix::Matrix(size_t rows, size_t cols) : rows(rows), cols(cols) {
         std::string message = std::format("Invalid rows or columns! Rows: {}, Columns: {}", rows, cols);
         throw std::invalid_argument(message);
     }
-    data = std::make_unique<std::vector<double>>(rows * cols, 0);
+    data = std::make_unique<Storage>(rows * cols, 0);
+    values = data->data();
 }
 
-// Deep Copy Constructor
+// Deep Copy Constructor - a copy of a view owns its elements
 Matrix::Matrix(const Matrix& other) : rows(other.rows), cols(other.cols) {
-    data = std::make_unique<std::vector<double>>(*other.data);
+    data = std::make_unique<Storage>(other.values, other.values + rows * cols);
+    values = data->data();
 }
 
+Matrix::Matrix(Matrix&& other) noexcept
+    : rows(other.rows), cols(other.cols), data(std::move(other.data)), values(other.values) {
+    other.rows = 0;
+    other.cols = 0;
+    other.values = nullptr;
+}
+
+Matrix::Matrix(double* values, size_t rows, size_t cols) : rows(rows), cols(cols), values(values) {}
+
+Matrix Matrix::view(double* values, size_t rows, size_t cols){
+    if (values == nullptr) throw std::invalid_argument("A matrix view needs memory to point at");
+
+    // views allocate nothing, so handing out batches stays allocation free
+    return Matrix(values, rows, cols);
+}
+
+bool Matrix::is_view() const { return data == nullptr && values != nullptr; }
+
 // Deep Copy Assignment
 Matrix& Matrix::operator=(const Matrix& other) {
     if (this == &other) return *this;  // Self-assignment check
 
     rows = other.rows;
     cols = other.cols;
-    data = std::make_unique<std::vector<double>>(*other.data);
+    // owned storage of the same size is overwritten instead of reallocated
+    if (data && data->size() == rows * cols) std::copy_n(other.values, rows * cols, data->data());
+    else data = std::make_unique<Storage>(other.values, other.values + rows * cols);
+    values = data->data();
     
     return *this;
 }
 
+Matrix& Matrix::operator=(Matrix&& other) noexcept {
+    if (this == &other) return *this;
+
+    rows = other.rows;
+    cols = other.cols;
+    data = std::move(other.data);
+    values = other.values;
+
+    other.rows = 0;
+    other.cols = 0;
+    other.values = nullptr;
+    return *this;
+}
+
 size_t Matrix::get_rows_count() const { return rows; }
 size_t Matrix::get_cols_count() const { return cols; }
 
+double* Matrix::get_data() { return values; }
+const double* Matrix::get_data() const { return values; }
+
 Matrix Matrix::transpose() const{
     Matrix result(cols, rows);
+    const double* src = values;
+    double* dst = result.values;
+
     for (size_t r = 0; r < rows; r++) {
         for (size_t c = 0; c < cols; c++) {
-            result(c, r) = (r, c);
+            dst[c * rows + r] = src[r * cols + c];
         }
     }
     return result;
 }
 
+void gemm(const Matrix& a, const Matrix& b, Matrix& out){
+    if (a.get_cols_count() != b.get_rows_count()) {
+        std::string message = std::format("Matrix dimensions do not match for multiplication. First dims {}x{}. Seconds dims {}x{}", 
+            a.get_rows_count(), a.get_cols_count(), b.get_rows_count(), b.get_cols_count());
+        throw std::invalid_argument(message);
+    }
+    if (out.get_rows_count() != a.get_rows_count() || out.get_cols_count() != b.get_cols_count()) {
+        throw std::invalid_argument(std::format("Result matrix must be {}x{}", a.get_rows_count(), b.get_cols_count()));
+    }
+
+    const size_t n = a.get_rows_count();
+    const size_t k = a.get_cols_count();
+    const size_t m = b.get_cols_count();
+    const double* A = a.get_data();
+    const double* B = b.get_data();
+    double* C = out.get_data();
+
+    std::fill(C, C + n * m, 0.0);
+
+    // i-k-j order: every C element still sums its products in increasing k, like the textbook loop,
+    // but the inner loop runs over contiguous rows of B and C. Blocking k keeps those B rows in cache
+    constexpr size_t block = 64;
+    for (size_t kk = 0; kk < k; kk += block) {
+        const size_t k_end = std::min(k, kk + block);
+        for (size_t i = 0; i < n; ++i) {
+            double* c_row = C + i * m;
+            for (size_t p = kk; p < k_end; ++p) {
+                const double a_ip = A[i * k + p];
+                const double* b_row = B + p * m;
+                for (size_t j = 0; j < m; ++j) {
+                    c_row[j] += a_ip * b_row[j];
+                }
+            }
+        }
+    }
+}
+
+void transpose_into(const Matrix& a, Matrix& out){
+    const size_t rows = a.get_rows_count();
+    const size_t cols = a.get_cols_count();
+    if (out.get_rows_count() != cols || out.get_cols_count() != rows) {
+        throw std::invalid_argument(std::format("Transposed matrix must be {}x{}", cols, rows));
+    }
+
+    const double* src = a.get_data();
+    double* dst = out.get_data();
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t c = 0; c < cols; c++) {
+            dst[c * rows + r] = src[r * cols + c];
+        }
+    }
+}
+
+void add_row_vector(Matrix& m, const Vector& row){
+    const size_t cols = m.get_cols_count();
+    if (cols != row.get_size()) {
+        throw std::invalid_argument(std::format("Cannot add a vector of {} elements to rows of {}", row.get_size(), cols));
+    }
+
+    double* values = m.get_data();
+    const double* add = row.get_data();
+    for (size_t r = 0; r < m.get_rows_count(); r++) {
+        for (size_t c = 0; c < cols; c++) {
+            values[r * cols + c] += add[c];
+        }
+    }
+}
+
+void column_sums(const Matrix& a, Vector& out){
+    const size_t rows = a.get_rows_count();
+    const size_t cols = a.get_cols_count();
+    if (out.get_size() != cols) {
+        throw std::invalid_argument(std::format("Column sums of {} columns do not fit a vector of {}", cols, out.get_size()));
+    }
+
+    // column by column with the rows in increasing order, the summation order of collapse_rows
+    const double* values = a.get_data();
+    double* sums = out.get_data();
+    for (size_t c = 0; c < cols; c++) {
+        double sum = 0;
+        for (size_t r = 0; r < rows; r++) {
+            sum += values[r * cols + c];
+        }
+        sums[c] = sum;
+    }
+}
+
 Matrix Matrix::operator*(const Matrix& other) const{
     if (this->cols != other.rows) {
         std::string message = std::format("Matrix dimensions do not match for multiplication. First dims {}x{}. Seconds dims {}x{}", 
@@ -52,14 +183,7 @@ Matrix Matrix::operator*(const Matrix& other) const{
     }
 
     Matrix result(this->rows, other.cols);
-
-    for (size_t i = 0; i < this->rows; ++i) {
-        for (size_t j = 0; j < other.cols; ++j) {
-            for (size_t k = 0; k < this->cols; ++k) {
-                result(i, j) += (i, k) * other(k, j);
-            }
-        }
-    }
+    gemm(*this, other, result);
 
     return result;
 }
@@ -73,7 +197,7 @@ Vector Matrix::operator*(const Vector& other) const{
 
     for (size_t i = 0; i < rows; ++i) {
         for (size_t j = 0; j < cols; ++j) {
-            result(i) += (i, j) * other(j);
+            result(i) += (*this)(i, j) * other(j);
         }
     }
 
@@ -85,7 +209,7 @@ Matrix Matrix::operator*(const double& scalar) const{
 
     for (size_t r = 0; r < rows; r++){
         for (size_t c = 0; c < cols; c++){
-            result(r, c) = (r, c) * scalar;
+            result(r, c) = (*this)(r, c) * scalar;
         }
     }
 
@@ -97,7 +221,7 @@ Matrix& Matrix::operator-=(const Matrix& other){
 
     for (size_t r = 0; r < rows; r++){
         for (size_t c = 0; c < cols; c++){
-            (r, c) -= other(r, c);
+            (*this)(r, c) -= other(r, c);
         }
     }
 
@@ -109,7 +233,7 @@ Matrix& Matrix::operator+=(const Matrix& other){
 
     for (size_t r = 0; r < rows; r++){
         for (size_t c = 0; c < cols; c++){
-            (r, c) += other(r, c);
+            (*this)(r, c) += other(r, c);
         }
     }
     return *this;
@@ -124,7 +248,7 @@ Matrix Matrix::operator-(const Matrix& other) const{
 
     for (size_t r = 0; r < rows; r++){
         for (size_t c = 0; c < cols; c++){
-            result(r, c) = (r, c) - other(r, c);
+            result(r, c) = (*this)(r, c) - other(r, c);
         }
     }
     
@@ -139,7 +263,7 @@ Matrix Matrix::elementwise_mult(const Matrix& other) const{
     Matrix result(rows, cols);
     for (size_t r = 0; r < rows; r++){
         for (size_t c = 0; c < cols; c++){
-            result(r, c) = (r, c) * other(r, c);
+            result(r, c) = (*this)(r, c) * other(r, c);
         }
     }
 
@@ -154,20 +278,21 @@ void Matrix::validate_indices(size_t r, size_t c) const {
 
 double Matrix::operator()(size_t r, size_t c) const{
     validate_indices(r, c);
-    return (*data)[r * cols + c];
+    return values[r * cols + c];
 }
 
 double& Matrix::operator()(size_t r, size_t c){
     validate_indices(r, c);
-    return (*data)[r * cols + c];
+    return values[r * cols + c];
 }
 
 Matrix Matrix::apply_to_elements(std::function<double(double)> func) const{
     Matrix new_matrix(this->rows, this->cols);
-    for (size_t r = 0; r < rows; r++){
-        for (size_t c = 0; c < cols; c++){
-            new_matrix(r, c) = func((r, c)); 
-        }
+    const double* src = values;
+    double* dst = new_matrix.values;
+
+    for (size_t i = 0; i < rows * cols; i++){
+        dst[i] = func(src[i]); 
     }
     return new_matrix;
 }
@@ -179,7 +304,7 @@ Vector Matrix::averaged_vector() const{
         
         double sum(0);
         for (size_t r = 0; r < rows; r++){
-            sum += (r, c);
+            sum += (*this)(r, c);
         }   
         result(c) = sum / rows;
     }
@@ -193,9 +318,13 @@ Matrix Matrix::elementwise_add(const Vector& other) const{
         throw std::runtime_error("Sizes must match");
     }
 
+    const double* src = values;
+    const double* bias = other.get_data();
+    double* dst = new_m.values;
+
     for (size_t r = 0; r < this->rows; r++){
         for (size_t c = 0; c < this->cols; c++){
-            new_m(r, c) = (r, c) + other(c);
+            dst[r * cols + c] = src[r * cols + c] + bias[c];
         }
     }
 
@@ -208,7 +337,7 @@ Vector Matrix::collapse_rows(){
     for(size_t c = 0; c < cols; c++){
         double sum(0);
         for (size_t r = 0; r < rows; r++){
-            sum += (r, c);
+            sum += (*this)(r, c);
         }
         result(c) = sum;
     }
@@ -220,7 +349,7 @@ void Matrix::print_matrix() const{
 
     for (size_t r = 0; r < rows; r++){
         for (size_t c = 0; c < cols; c++){
-            std::cout << (r, c) << " ";
+            std::cout << (*this)(r, c) << " ";
         }
         std::cout << "\n";
     }
@@ -2,6 +2,7 @@
 #include <stdexcept>
 #include <format>
 #include <iostream>
+#include <algorithm>
 
 namespace lin_alg{
 
@@ -9,32 +10,64 @@ Vector::Vector(size_t size) : size(size) {
     if (size < 1) {
         throw std::invalid_argument(std::format("Vector size must be >= 1. Given: {}", size));
     }
-    data = std::make_unique<std::vector<double>>(size, 0.0);
+    data = std::make_unique<Storage>(size, 0.0);
+    values = data->data();
 }
 
-// Deep Copy Constructor
+// Deep Copy Constructor - a copy of a view owns its elements
 Vector::Vector(const Vector& other) : size(other.size) {
-    data = std::make_unique<std::vector<double>>(*other.data);
+    data = std::make_unique<Storage>(other.values, other.values + size);
+    values = data->data();
 }
 
+Vector::Vector(Vector&& other) noexcept : size(other.size), data(std::move(other.data)), values(other.values) {
+    other.size = 0;
+    other.values = nullptr;
+}
+
+Vector::Vector(double* values, size_t size) : size(size), values(values) {}
+
+Vector Vector::view(double* values, size_t size){
+    if (values == nullptr) throw std::invalid_argument("A vector view needs memory to point at");
+
+    return Vector(values, size);
+}
+
+bool Vector::is_view() const { return data == nullptr && values != nullptr; }
+
 
 // Deep Copy Assignment
 Vector& Vector::operator=(const Vector& other) {
     if (this == &other) return *this;  // Self-assignment check
 
     size = other.size;
-    data = std::make_unique<std::vector<double>>(*other.data);
+    // owned storage of the same size is overwritten instead of reallocated
+    if (data && data->size() == size) std::copy_n(other.values, size, data->data());
+    else data = std::make_unique<Storage>(other.values, other.values + size);
+    values = data->data();
 
     return *this;
 }
 
+Vector& Vector::operator=(Vector&& other) noexcept {
+    if (this == &other) return *this;
+
+    size = other.size;
+    data = std::move(other.data);
+    values = other.values;
+
+    other.size = 0;
+    other.values = nullptr;
+    return *this;
+}
+
 Vector& Vector::operator-=(const Vector& other) {
     if (this->size != other.size) {
         throw std::invalid_argument("Vector sizes must be equal!");
     }
 
     for (size_t i = 0; i < size; i++) {
-        (i) -= other(i);
+        (*this)(i) -= other(i);
     }
 
     return *this; 
@@ -44,7 +77,7 @@ Vector& Vector::operator+=(const Vector& other){
     if (this->size != other.size) throw std::invalid_argument("Vector sizes must be equal!");
 
     for (size_t i = 0; i < size; i++){
-        (i) += other(i);
+        (*this)(i) += other(i);
     }
 
     return *this;
@@ -60,7 +93,7 @@ Vector Vector::operator*(const Matrix& other) const{
     for (size_t j = 0; j < other.get_cols_count(); ++j) {
         double sum = 0.0;
         for (size_t i = 0; i < size; ++i) {
-            sum += (i) * other(i, j);
+            sum += (*this)(i) * other(i, j);
         }
         result(j) = sum;
     }
@@ -69,11 +102,15 @@ Vector Vector::operator*(const Matrix& other) const{
 }
 
 Vector::Vector(const std::vector<double>& other) : size(other.size()) {
-    data = std::make_unique<std::vector<double>>(other);
+    data = std::make_unique<Storage>(other.begin(), other.end());
+    values = data->data();
 }
 
 size_t Vector::get_size() const { return size; }
 
+double* Vector::get_data() { return values; }
+const double* Vector::get_data() const { return values; }
+
 void Vector::validate_index(size_t i) const {
     if (i >= size) {
         throw std::out_of_range("Index out of range");
@@ -82,19 +119,19 @@ void Vector::validate_index(size_t i) const {
 
 const double Vector::operator()(size_t i) const {
     validate_index(i);
-    return (*data)[i];
+    return values[i];
 }
 
 double& Vector::operator()(size_t i) {
     validate_index(i);
-    return (*data)[i];
+    return values[i];
 }
 
 // Vector Scalar    ication
 Vector Vector::operator*(double scalar) const{
     Vector result(size);
     for (size_t i = 0; i < size; ++i) {
-        result(i) = (i) * scalar;
+        result(i) = (*this)(i) * scalar;
     }
     return result;
 }
@@ -106,7 +143,7 @@ Vector Vector::operator+(const Vector& other) const{
 
     Vector result(size);
     for (size_t i = 0; i < size; i++){
-        result(i) = (i) + other(i);
+        result(i) = (*this)(i) + other(i);
     }
 
     return result;
@@ -116,7 +153,7 @@ Vector Vector::operator+(const Vector& other) const{
 Matrix Vector::transpose() const {
     Matrix result(1, size);
     for (size_t i = 0; i < size; i++) {
-        result(0, i) = (i);
+        result(0, i) = (*this)(i);
     }
     return result;
 }
@@ -143,7 +180,7 @@ Vector Vector::from_matrix_row(const Matrix& input, size_t row){
 
 void Vector::print() const{
     for (size_t i = 0; i < size; i++){
-        std::cout << (i) << " ";
+        std::cout << (*this)(i) << " ";
     }
     std::cout << std::endl;
 }
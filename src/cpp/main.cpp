@@ -1,35 +1,208 @@
 
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <string>
+#include <cstring>
 #include "linear_algebra/lin_alg.h"
 #include "neural_network/neural_network.h"
 #include "file/reader.h"
+#include "file/text_stream.h"
+#include "diagnostics/trace.h"
 
+/// @brief Times one training epoch for every thread count from 1 to the number of cores
+/// and prints the throughput and the speedup over the single threaded run
+void report_scaling(const neural_network::Dataset& samples, int batch_size){
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    double single_thread_time = 0;
 
-int main(){
-    file_handling::FileReader reader("C:\\Users\\denis\\Desktop\\Геодезия\\Невронни мрежи\\test_data\\0.1-training.txt");
+    neural_network::Dataset normalized = samples;
+    neural_network::NeuralNetwork(batch_size).normalize(normalized);
 
-    std::vector<neural_network::TrainingSample> samples = reader.readTrainingData();
+    PRINT("threads, epoch ms, samples/s, speedup")
+    for (size_t threads = 1; threads <= max_threads; threads++){
+        // the same initial weights for every thread count
+        neural_network::NeuralNetwork network(batch_size, 1);
+
+        auto start = std::chrono::steady_clock::now();
+        network.train(normalized, 1, 0.25, threads);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (threads == 1) single_thread_time = elapsed.count();
+        PRINT(threads << ", " << elapsed.count() * 1000 << ", " << samples.get_row_count() / elapsed.count()
+            << ", " << single_thread_time / elapsed.count())
+    }
+}
+
+/// @brief Trains the same seeded network on one thread and on every core with a fixed gradient shard count
+/// and checks that both runs end with bit-for-bit the same predictions
+void report_reproducibility(const neural_network::Dataset& samples, int batch_size, uint64_t seed){
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    neural_network::Dataset normalized = samples;
+    neural_network::NeuralNetwork(batch_size).normalize(normalized);
+
+    std::vector<lin_alg::Matrix> predictions;
+    for (size_t threads : {size_t(1), max_threads}){
+        neural_network::NeuralNetwork network(batch_size, seed);
+        neural_network::TrainingOptions options;
+        options.epochs = 5;
+        options.schedule = std::make_shared<neural_network::ConstantSchedule>(0.25);
+        options.threads = threads;
+        options.gradient_shards = 8;
+        network.train(normalized, options);
+        predictions.push_back(network.predict_batch(samples.get_features()));
+    }
+
+    const lin_alg::Matrix& single = predictions.front();
+    const lin_alg::Matrix& parallel = predictions.back();
+    bool identical = std::memcmp(single.get_data(), parallel.get_data(),
+        single.get_rows_count() * single.get_cols_count() * sizeof(double)) == 0;
+    PRINT("Seed " << seed << ", 1 vs " << max_threads << " threads: " << (identical ? "bitwise identical" : "DIFFERENT"))
+}
+
+int main(int argc, char* argv[]){
+    const std::string training_file = "C:\\Users\\denis\\Desktop\\Геодезия\\Невронни мрежи\\test_data\\0.1-training.txt";
+
+    if (argc > 1 && std::string(argv[1]) == "--streaming"){
+        // trains straight from the file, the data set is never loaded as a whole
+        file_handling::TextFileStream stream(training_file);
+        neural_network::NeuralNetwork network(20);
+        neural_network::StreamingStats stats = network.train_streaming(stream, 500, 0.25);
+        PRINT("Streamed " << stats.rows << " rows: " << stats.rows_per_second << " rows/s, buffers " << stats.buffered_bytes
+            << " bytes, peak RSS " << stats.peak_rss_bytes << " bytes")
+        return 0;
+    }
+
+    // --trace <file>: records spans from loading the data to the end of a short run, for chrome://tracing or Perfetto
+    const bool tracing = argc > 2 && std::string(argv[1]) == "--trace";
+    if (tracing){
+        diagnostics::set_trace_thread_name("main");
+        diagnostics::start_trace();
+    }
+
+    file_handling::FileReader reader(training_file);
+
+    neural_network::Dataset samples = reader.readDatasetCached();
     
     // Testing with LITERALLY the same dataset and still cannot get it to work :/
     file_handling::FileReader test_data_reader("C:\\Users\\denis\\Desktop\\Геодезия\\Невронни мрежи\\test_data\\12.1.txt");
-    std::vector<neural_network::TrainingSample> test_samples = test_data_reader.readTrainingData();
+    neural_network::Dataset test_samples = test_data_reader.readDatasetCached();
 
     int batch_size(20);
+
+    if (argc > 1 && std::string(argv[1]) == "--scaling"){
+        report_scaling(samples, batch_size);
+        return 0;
+    }
+
+    // --reproducible [seed]
+    if (argc > 1 && std::string(argv[1]) == "--reproducible"){
+        report_reproducibility(samples, batch_size, argc > 2 ? std::stoull(argv[2]) : 1);
+        return 0;
+    }
+
     neural_network::NeuralNetwork network(batch_size);
+    network.fit_normalizer(samples, neural_network::NormalizationKind::MinMax);
 
-    try{
+    // training and validation sets are normalized once here, test() takes raw inputs like predict_batch
+    neural_network::Dataset training_set = samples;
+    network.normalize(training_set);
+    neural_network::Dataset validation_set = test_samples;
+    network.normalize(validation_set);
+
+    if (tracing){
+        network.train(training_set, 20, 0.25, std::max(1u, std::thread::hardware_concurrency()));
         network.test(samples);
-        network.train(samples, 100, 0.25);
+        diagnostics::stop_trace();
+        diagnostics::write_chrome_trace(argv[2]);
+        PRINT("Trace written to " << argv[2])
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--async"){
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<neural_network::TrainingSample> sample_rows = samples.to_samples();
+        neural_network::AsyncTrainingStats stats = network.train_async(sample_rows, 500, 0.25, threads);
+        PRINT("Async training on " << threads << " threads: " << stats.samples_per_second << " samples/s, staleness mean "
+            << stats.mean_staleness << " max " << stats.max_staleness)
         network.test(samples);
-        network.train(samples, 500, 0.25);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--pipelined"){
+        neural_network::PipelineStats stats = network.train_pipelined(samples.to_samples(), 500, 0.25);
+        PRINT("Batches: " << stats.batches)
+        PRINT("Shuffle: " << stats.shuffle_seconds << " s, assemble: " << stats.assemble_seconds
+            << " s, normalize: " << stats.normalize_seconds << " s, producer stalled: " << stats.producer_wait_seconds << " s")
+        PRINT("Compute: " << stats.compute_seconds << " s, waiting for input: " << stats.input_wait_seconds << " s -> "
+            << (stats.input_wait_seconds > 0.1 * stats.compute_seconds ? "input bound" : "compute bound"))
         network.test(samples);
-        network.train(samples, 500, 0.15);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--checkpointing"){
+        for (size_t k = 1; k <= 3; k++){
+            neural_network::NeuralNetwork checkpointed(batch_size);
+            checkpointed.set_activation_checkpointing(k);
+            checkpointed.set_normalizer(network.get_normalizer());
+            checkpointed.train(training_set, 1, 0.25);
+
+            neural_network::ActivationMemoryStats stats = checkpointed.get_activation_stats();
+            PRINT("Checkpoint every " << k << " layers: peak " << stats.peak_bytes << " bytes, "
+                << stats.recomputed_layers << " recomputed / " << stats.layer_forwards << " layer forwards")
+        }
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--find-lr"){
+        std::vector<neural_network::TrainingSample> sample_rows = samples.to_samples();
+        neural_network::LearningRateSweep sweep = network.find_learning_rate(sample_rows, 1e-6, 10, 300, "lr_finder.csv");
+        PRINT("Suggested learning rate: " << sweep.suggested_rate << " (loss curve in lr_finder.csv)")
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--adam"){
+        network.set_optimizer(std::make_shared<neural_network::Adam>());
+
+        auto start = std::chrono::steady_clock::now();
+        network.train(training_set, 200, 0.005);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        PRINT("Adam, 200 epochs: " << elapsed.count() << " s")
         network.test(samples);
-        network.train(samples, 500, 0.15);
+        return 0;
+    }
+
+    try{
+        neural_network::TrainingOptions options;
+        options.epochs = 2100;
+        options.schedule = std::make_shared<neural_network::PiecewiseSchedule>(
+            std::vector<std::pair<int, double>>{{0, 0.25}, {600, 0.15}, {1600, 0.05}});
+        options.validation_data = &validation_set;
+        options.eval_every = 50;
+        options.patience = 4;
+        options.checkpoint_path = "training.ckpt";
+        options.checkpoint_every = 100;
+        if (argc > 1 && std::string(argv[1]) == "--resume") options.resume_from = options.checkpoint_path;
+        options.telemetry_path = "training_telemetry.jsonl";
+
         network.test(samples);
-        network.train(samples, 500, 0.05);
+        neural_network::TrainingResult result = network.train(training_set, options);
+        PRINT("Epochs: " << result.epochs_run << ", best validation RMSE " << result.best_validation_rmse
+            << " after epoch " << result.best_epoch << (result.stopped_early ? " (stopped early)" : ""))
+        PRINT("Checkpoints: " << result.checkpoints.written << " written (" << result.checkpoints.bytes_written << " bytes), "
+            << result.checkpoints.superseded << " superseded, " << result.checkpoints.failed << " failed; training paused "
+            << result.checkpoints.snapshot_seconds << " s for snapshots, background writes took " << result.checkpoints.write_seconds << " s")
+        if (result.checkpoints.failed > 0) PRINT("Last checkpoint error: " << result.checkpoints.last_error)
         network.test(samples);
-        
+
+        if (argc > 2 && std::string(argv[1]) == "--save"){
+            network.save(argv[2]);
+            PRINT("Model written to " << argv[2])
+        }
+
     }
     catch (const std::exception& e){
         PRINT("Exception...")
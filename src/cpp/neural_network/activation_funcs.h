@@ -1,36 +1,230 @@
 #pragma once
 #include <cmath>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <variant>
+#include <algorithm>
+#include <stdexcept>
+#include <format>
 
 
 namespace neural_network{
 
+    /// @brief Stable identifiers of the activation functions, as stored in model files. Never renumber them
+    enum class ActivationId : uint32_t{
+        ReLU = 1,
+        Sigmoid = 2,
+        LeakyReLU = 3,
+        Tanh = 4,
+        GELU = 5,
+        Softmax = 6
+    };
+
+    // Element kernels: value(x) of a pre-activation x, derivative(x, y) with y = value(x). Kernels that can take
+    // the derivative from y alone have uses_pre_activation = false and ignore x, so the backward pass works from
+    // the layer outputs it keeps anyway. The piecewise kernels are written as max() and selects rather than
+    // branches, so the batch loops below vectorize. Row-wise kernels (row_wise = true) work on a whole row of a batch
+
+    struct ReLUKernel{
+        static constexpr ActivationId id = ActivationId::ReLU;
+        static constexpr bool uses_pre_activation = false;
+        static constexpr bool row_wise = false;
+
+        double value(double x) const { return std::max(x, 0.0); }
+        double derivative(double, double y) const { return static_cast<double>(y > 0); }
+    };
+
+    struct LeakyReLUKernel{
+        static constexpr ActivationId id = ActivationId::LeakyReLU;
+        static constexpr bool uses_pre_activation = false;
+        static constexpr bool row_wise = false;
+        // fixed, model files only store the activation id
+        static constexpr double slope = 0.01;
+
+        // max(x, slope * x) is x for x > 0 and slope * x otherwise, as long as slope < 1
+        double value(double x) const { return std::max(x, slope * x); }
+        double derivative(double, double y) const { return y > 0 ? 1.0 : slope; }
+    };
+
+    struct SigmoidKernel{
+        static constexpr ActivationId id = ActivationId::Sigmoid;
+        static constexpr bool uses_pre_activation = false;
+        static constexpr bool row_wise = false;
+
+        double value(double x) const { return 1 / (1 + std::exp(-x)); }
+        double derivative(double, double y) const { return y * (1 - y); }
+    };
+
+    struct TanhKernel{
+        static constexpr ActivationId id = ActivationId::Tanh;
+        static constexpr bool uses_pre_activation = false;
+        static constexpr bool row_wise = false;
+
+        double value(double x) const { return std::tanh(x); }
+        double derivative(double, double y) const { return 1 - y * y; }
+    };
+
+    /// @brief The tanh approximation of GELU, 0.5x(1 + tanh(sqrt(2/pi)(x + 0.044715x^3))).
+    /// GELU is not monotonic, so its derivative needs the pre-activation
+    struct GELUKernel{
+        static constexpr ActivationId id = ActivationId::GELU;
+        static constexpr bool uses_pre_activation = true;
+        static constexpr bool row_wise = false;
+        static constexpr double c = 0.7978845608028654;    // sqrt(2 / pi)
+        static constexpr double a = 0.044715;
+
+        double value(double x) const { return 0.5 * x * (1 + std::tanh(c * (x + a * x * x * x))); }
+        double derivative(double x, double) const {
+            const double t = std::tanh(c * (x + a * x * x * x));
+            return 0.5 * (1 + t) + 0.5 * x * (1 - t * t) * c * (1 + 3 * a * x * x);
+        }
+    };
+
+    /// @brief Softmax over every row of a batch, y_c = exp(x_c - max_j x_j) / sum_j exp(x_j - max_j x_j).
+    /// Its derivative is the Jacobian diag(y) - y y^T, applied to a whole row at once
+    struct SoftmaxKernel{
+        static constexpr ActivationId id = ActivationId::Softmax;
+        static constexpr bool uses_pre_activation = false;
+        static constexpr bool row_wise = true;
+
+        // the softmax of a single element row, and the diagonal of the Jacobian
+        double value(double) const { return 1; }
+        double derivative(double, double y) const { return y * (1 - y); }
+
+        void apply_row(const double* x, double* y, size_t width) const {
+            double max = x[0];
+            for (size_t c = 1; c < width; c++) max = std::max(max, x[c]);
+
+            double sum = 0;
+            for (size_t c = 0; c < width; c++){
+                y[c] = std::exp(x[c] - max);
+                sum += y[c];
+            }
+            const double scale = 1 / sum;
+            for (size_t c = 0; c < width; c++) y[c] *= scale;
+        }
+
+        /// @brief v = (diag(y) - y y^T) v, i.e. v_c = y_c (v_c - sum_j v_j y_j)
+        void scale_row(const double* y, double* v, size_t width) const {
+            double dot = 0;
+            for (size_t c = 0; c < width; c++) dot += v[c] * y[c];
+            for (size_t c = 0; c < width; c++) v[c] = y[c] * (v[c] - dot);
+        }
+    };
+
+    /// @brief Every activation as a value, for dispatch with std::visit once per batch instead of a virtual call per element
+    using ActivationKernel = std::variant<ReLUKernel, LeakyReLUKernel, SigmoidKernel, TanhKernel, GELUKernel, SoftmaxKernel>;
+
+    /// @brief out[i] = value(in[i]); in and out may be the same span. row_width is the column count of the batch
+    /// the spans hold, only row-wise kernels need it
+    template <typename Kernel>
+    void apply_kernel(const Kernel& kernel, std::span<const double> in, std::span<double> out, size_t row_width){
+        const double* x = in.data();
+        double* y = out.data();
+        if constexpr (Kernel::row_wise){
+            for (size_t r = 0; r < in.size(); r += row_width) kernel.apply_row(x + r, y + r, row_width);
+        }
+        else{
+            for (size_t i = 0; i < in.size(); i++) y[i] = kernel.value(x[i]);
+        }
+    }
+
+    /// @brief out[i] = derivative at the outputs y = value(x); pre_activation (x) is only read when the kernel uses it.
+    /// Row-wise kernels give the diagonal of their Jacobian
+    template <typename Kernel>
+    void kernel_derivative(const Kernel& kernel, std::span<const double> pre_activation, std::span<const double> output, std::span<double> out){
+        const double* y = output.data();
+        double* d = out.data();
+        if constexpr (Kernel::uses_pre_activation){
+            const double* x = pre_activation.data();
+            for (size_t i = 0; i < output.size(); i++) d[i] = kernel.derivative(x[i], y[i]);
+        }
+        else{
+            for (size_t i = 0; i < output.size(); i++) d[i] = kernel.derivative(0.0, y[i]);
+        }
+    }
+
+    /// @brief values[i] *= derivative at output[i] - the backward pass's delta = error (.) f'(x) without a temporary.
+    /// Row-wise kernels multiply every row of values by their Jacobian instead
+    template <typename Kernel>
+    void scale_by_derivative(const Kernel& kernel, std::span<const double> pre_activation, std::span<const double> output,
+        std::span<double> values, size_t row_width){
+        const double* y = output.data();
+        double* v = values.data();
+        if constexpr (Kernel::row_wise){
+            for (size_t r = 0; r < output.size(); r += row_width) kernel.scale_row(y + r, v + r, row_width);
+        }
+        else if constexpr (Kernel::uses_pre_activation){
+            const double* x = pre_activation.data();
+            for (size_t i = 0; i < output.size(); i++) v[i] *= kernel.derivative(x[i], y[i]);
+        }
+        else{
+            for (size_t i = 0; i < output.size(); i++) v[i] *= kernel.derivative(0.0, y[i]);
+        }
+    }
+
     class ActivationFunc {
         public:
             virtual double apply(double input) = 0;  // Forward pass
-            virtual double applyDerivative(double input) = 0;  // Derivative for backpropagation
-            virtual ~ActivationFunc() = default;  
+            virtual double applyDerivative(double input) = 0;  // Derivative at the pre-activation, for backpropagation
+            virtual ActivationId get_id() const = 0;
+
+            /// @brief out[i] = f(in[i]) over a whole batch of rows with row_width columns; in and out may be the same span
+            virtual void apply(std::span<const double> in, std::span<double> out, size_t row_width) const = 0;
+            void apply_in_place(std::span<double> values, size_t row_width) const { apply(values, values, row_width); }
+
+            /// @brief out[i] = f'(x[i]) from the outputs y = f(x), the diagonal of the Jacobian for Softmax.
+            /// pre_activation (x) is only read when uses_pre_activation()
+            virtual void derivative(std::span<const double> pre_activation, std::span<const double> output, std::span<double> out) const = 0;
+            virtual bool uses_pre_activation() const = 0;
+
+            /// @brief The element kernel, for hot loops that resolve the activation once per batch with std::visit
+            virtual ActivationKernel kernel() const = 0;
+
+            virtual ~ActivationFunc() = default;
         };
-        
-        class ReLU : public ActivationFunc {
+
+        /// @brief Implements ActivationFunc with an element kernel
+        template <typename Kernel>
+        class KernelActivation : public ActivationFunc {
+        protected:
+            Kernel element;
+
         public:
-            double apply(double input) override {
-                return input > 0 ? input : 0;  // ReLU: max(0, x)
+            double apply(double input) override { return element.value(input); }
+            double applyDerivative(double input) override { return element.derivative(input, element.value(input)); }
+            ActivationId get_id() const override { return Kernel::id; }
+
+            void apply(std::span<const double> in, std::span<double> out, size_t row_width) const override {
+                apply_kernel(element, in, out, row_width);
             }
-        
-            double applyDerivative(double input) override {
-                return input > 0 ? 1 : 0;  // ReLU derivative: 1 if x > 0, else 0
+
+            void derivative(std::span<const double> pre_activation, std::span<const double> output, std::span<double> out) const override {
+                kernel_derivative(element, pre_activation, output, out);
             }
+
+            bool uses_pre_activation() const override { return Kernel::uses_pre_activation; }
+            ActivationKernel kernel() const override { return element; }
         };
-        
-        class Sigmoid : public ActivationFunc {
-        public:
-            double apply(double input) override {
-                return 1 / (1 + exp(-input));  // Sigmoid: 1 / (1 + e^(-x))
-            }
-        
-            double applyDerivative(double input) override {
-                double sigmoid_value = apply(input);
-                return sigmoid_value * (1 - sigmoid_value);  // Sigmoid derivative: σ(x) * (1 - σ(x))
+
+        class ReLU : public KernelActivation<ReLUKernel> {};
+        class LeakyReLU : public KernelActivation<LeakyReLUKernel> {};
+        class Sigmoid : public KernelActivation<SigmoidKernel> {};
+        class Tanh : public KernelActivation<TanhKernel> {};
+        class GELU : public KernelActivation<GELUKernel> {};
+        class Softmax : public KernelActivation<SoftmaxKernel> {};
+
+        /// @brief Creates the activation function with the given id, e.g. when loading a model file
+        inline std::shared_ptr<ActivationFunc> make_activation(ActivationId id){
+            switch (id){
+                case ActivationId::ReLU: return std::make_shared<ReLU>();
+                case ActivationId::Sigmoid: return std::make_shared<Sigmoid>();
+                case ActivationId::LeakyReLU: return std::make_shared<LeakyReLU>();
+                case ActivationId::Tanh: return std::make_shared<Tanh>();
+                case ActivationId::GELU: return std::make_shared<GELU>();
+                case ActivationId::Softmax: return std::make_shared<Softmax>();
             }
-        };
-}
\ No newline at end of file
+            throw std::invalid_argument(std::format("Unknown activation id {}", static_cast<uint32_t>(id)));
+        }
+}
@@ -0,0 +1,132 @@
+#include "neural_network.h"
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <span>
+#include <mutex>
+#include <exception>
+
+namespace neural_network{
+
+// Hogwild-style parameter access: every element is read and written through relaxed atomics,
+// so concurrent workers never tear a value, but updates from different workers may overwrite each other
+static void load_relaxed(double* shared, double* local, size_t count){
+    for (size_t i = 0; i < count; i++){
+        local[i] = std::atomic_ref<double>(shared[i]).load(std::memory_order_relaxed);
+    }
+}
+
+static void step_relaxed(double* shared, const double* grads, size_t count, double learning_rate){
+    for (size_t i = 0; i < count; i++){
+        std::atomic_ref<double> param(shared[i]);
+        param.store(param.load(std::memory_order_relaxed) - grads[i] * learning_rate, std::memory_order_relaxed);
+    }
+}
+
+AsyncTrainingStats NeuralNetwork::train_async(std::vector<TrainingSample>& training_data, int epochs, double learning_rate, size_t threads){
+    if (threads == 0) throw std::invalid_argument("Thread count must be >= 1");
+
+    Dataset dataset = Dataset::from_samples(training_data);
+    normalize(dataset);
+    std::vector<TrainingBatch> batches = create_batches(dataset);
+    const size_t batch_count = batches.size();
+    const size_t epoch_count = epochs > 0 ? static_cast<size_t>(epochs) : 0;
+    const size_t total_batches = batch_count * epoch_count;
+
+    // the batch order of every epoch is drawn up front from stream (EpochOrder, epoch), the one train() uses,
+    // so workers that straddle an epoch boundary need no coordination
+    std::vector<uint32_t> batch_order(total_batches);
+    for (size_t epoch = 0; epoch < epoch_count; epoch++){
+        std::span<uint32_t> order(batch_order.data() + epoch * batch_count, batch_count);
+        std::iota(order.begin(), order.end(), 0u);
+        RandomStream(seed, RandomStreamKind::EpochOrder, static_cast<uint32_t>(epoch)).shuffle(order);
+    }
+
+    // the work queue: workers claim (epoch, batch) slots with a single fetch_add, no locks involved
+    std::atomic<size_t> next_slot{0};
+    // counts applied updates - the distance between two readings is the staleness of a gradient
+    std::atomic<size_t> version{0};
+
+    // the first exception of any worker; it also ends the queue so the other workers stop after their current batch
+    std::mutex error_mutex;
+    std::exception_ptr first_error;
+
+    std::vector<AsyncTrainingStats> worker_stats(threads);
+    // replicas are taken before any worker starts writing to the shared parameters
+    std::vector<NeuralNetwork> replicas(threads, *this);
+
+    auto work = [&](size_t id) {
+        NeuralNetwork& replica = replicas[id];
+        ForwardContext ctx;
+        AsyncTrainingStats& stats = worker_stats[id];
+
+        for (size_t slot = next_slot.fetch_add(1); slot < total_batches; slot = next_slot.fetch_add(1)){
+            const TrainingBatch& batch = batches[batch_order[slot]];
+
+            size_t read_version = version.load(std::memory_order_relaxed);
+            for (size_t l = 0; l < layers.size(); l++){
+                lin_alg::Matrix& weights = replica.layers[l].expose_weights();
+                lin_alg::Vector& biases = replica.layers[l].expose_biases();
+                load_relaxed(layers[l].expose_weights().get_data(), weights.get_data(), weights.get_rows_count() * weights.get_cols_count());
+                load_relaxed(layers[l].expose_biases().get_data(), biases.get_data(), biases.get_size());
+            }
+
+            replica.forward(batch.inputs, ctx);
+            const std::vector<LayerGradients>& gradients = replica.compute_gradients(batch, ctx);
+
+            for (size_t l = 0; l < layers.size(); l++){
+                const LayerGradients& grad = gradients[l];
+                step_relaxed(layers[l].expose_weights().get_data(), grad.weights.get_data(),
+                    grad.weights.get_rows_count() * grad.weights.get_cols_count(), learning_rate);
+                step_relaxed(layers[l].expose_biases().get_data(), grad.biases.get_data(), grad.biases.get_size(), learning_rate);
+            }
+
+            size_t staleness = version.fetch_add(1, std::memory_order_relaxed) - read_version;
+            stats.updates++;
+            stats.samples += batch.inputs.get_rows_count();
+            stats.mean_staleness += staleness;
+            stats.max_staleness = std::max(stats.max_staleness, staleness);
+        }
+    };
+
+    auto worker = [&](size_t id) {
+        try{
+            work(id);
+        }
+        catch (...){
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!first_error) first_error = std::current_exception();
+            next_slot.store(total_batches);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++){
+        workers.emplace_back(worker, t);
+    }
+    worker(0);
+    for (std::thread& t : workers){
+        t.join();
+    }
+    if (first_error) std::rethrow_exception(first_error);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    AsyncTrainingStats total;
+    for (const AsyncTrainingStats& stats : worker_stats){
+        total.updates += stats.updates;
+        total.samples += stats.samples;
+        total.mean_staleness += stats.mean_staleness;
+        total.max_staleness = std::max(total.max_staleness, stats.max_staleness);
+    }
+    total.seconds = elapsed.count();
+    total.samples_per_second = total.seconds > 0 ? total.samples / total.seconds : 0;
+    total.mean_staleness = total.updates > 0 ? total.mean_staleness / total.updates : 0;
+
+    return total;
+}
+}
@@ -0,0 +1,141 @@
+#include "batch_pipeline.h"
+#include "../diagnostics/trace.h"
+#include <numeric>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <utility>
+
+namespace neural_network{
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point start){
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+BatchPipeline::BatchPipeline(const std::vector<TrainingSample>& samples, size_t batch_size, int epochs, uint64_t seed,
+    std::function<void(lin_alg::Matrix&)> normalize, size_t depth)
+    : samples(samples), batch_size(batch_size), epochs(epochs), seed(seed), normalize(std::move(normalize)) {
+    if (samples.empty()) throw std::invalid_argument("Cannot build batches from an empty data set");
+    if (batch_size == 0 || depth == 0) throw std::invalid_argument("Batch size and pipeline depth must be >= 1");
+
+    size_t rows = std::min(batch_size, samples.size());
+    size_t input_cols = samples.front().input_data.size();
+    size_t output_cols = samples.front().expected_output.size();
+    ring.reserve(depth);
+    for (size_t i = 0; i < depth; i++){
+        TrainingBatch buffers(lin_alg::Matrix(rows, input_cols), lin_alg::Matrix(rows, output_cols));
+        // the views stay valid when the slot is moved, the moved matrices keep their storage
+        TrainingBatch batch(lin_alg::Matrix::view(buffers.inputs.get_data(), rows, input_cols),
+            lin_alg::Matrix::view(buffers.expected_outputs.get_data(), rows, output_cols));
+        ring.push_back(Slot{std::move(buffers), std::move(batch)});
+    }
+
+    producer = std::thread([this]() { produce(); });
+}
+
+BatchPipeline::~BatchPipeline(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    slot_freed.notify_all();
+    producer.join();
+}
+
+void BatchPipeline::fill_batch(Slot& slot, const std::vector<size_t>& order, size_t offset, size_t rows){
+    size_t input_cols = slot.buffers.inputs.get_cols_count();
+    size_t output_cols = slot.buffers.expected_outputs.get_cols_count();
+    double* inputs = slot.buffers.inputs.get_data();
+    double* outputs = slot.buffers.expected_outputs.get_data();
+
+    // only the last batch of an epoch can be shorter - it views fewer rows of the same buffers
+    slot.batch.inputs = lin_alg::Matrix::view(inputs, rows, input_cols);
+    slot.batch.expected_outputs = lin_alg::Matrix::view(outputs, rows, output_cols);
+
+    for (size_t i = 0; i < rows; ++i) {
+        const TrainingSample& ts = samples[order[offset + i]];
+        std::copy_n(ts.input_data.begin(), input_cols, inputs + i * input_cols);
+        std::copy_n(ts.expected_output.begin(), output_cols, outputs + i * output_cols);
+    }
+}
+
+void BatchPipeline::produce(){
+    diagnostics::set_trace_thread_name("batch producer");
+    try{
+        std::vector<size_t> order(samples.size());
+
+        for (int epoch = 0; epoch < epochs; epoch++){
+            Clock::time_point start = Clock::now();
+            // from the identity every epoch, so an epoch's order depends on the seed and the epoch number alone
+            std::iota(order.begin(), order.end(), 0);
+            RandomStream(seed, RandomStreamKind::PipelineOrder, static_cast<uint32_t>(epoch)).shuffle(std::span(order));
+            stats.shuffle_seconds += seconds_since(start);
+
+            for (size_t offset = 0; offset < order.size(); offset += batch_size){
+                start = Clock::now();
+                Slot* slot;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    slot_freed.wait(lock, [&]() { return stopping || produced - consumed < ring.size(); });
+                    if (stopping) return;
+                    slot = &ring[produced % ring.size()];
+                }
+                stats.producer_wait_seconds += seconds_since(start);
+
+                diagnostics::TraceSpan span("data", "assemble_batch", offset / batch_size);
+                start = Clock::now();
+                fill_batch(*slot, order, offset, std::min(batch_size, order.size() - offset));
+                stats.assemble_seconds += seconds_since(start);
+
+                start = Clock::now();
+                normalize(slot->batch.inputs);
+                stats.normalize_seconds += seconds_since(start);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    produced++;
+                }
+                slot_filled.notify_one();
+            }
+        }
+    }
+    catch (...){
+        std::lock_guard<std::mutex> lock(mutex);
+        producer_error = std::current_exception();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    slot_filled.notify_one();
+}
+
+const TrainingBatch* BatchPipeline::acquire(){
+    Clock::time_point start = Clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    slot_filled.wait(lock, [&]() { return finished || produced > consumed; });
+    stats.input_wait_seconds += seconds_since(start);
+
+    if (produced > consumed) return &ring[consumed % ring.size()].batch;
+    if (producer_error) std::rethrow_exception(producer_error);
+    return nullptr;
+}
+
+void BatchPipeline::release(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        consumed++;
+        stats.batches++;
+    }
+    slot_freed.notify_one();
+}
+
+PipelineStats BatchPipeline::get_stats(){
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+}
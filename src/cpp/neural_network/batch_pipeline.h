@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include "neural_network.h"
+
+namespace neural_network{
+
+    /// @brief Assembles, normalizes and shuffles training batches on a dedicated producer thread.
+    /// The batches are written into a ring of preallocated buffers, so the next batches are ready
+    /// while the trainer is still busy with the current one
+    class BatchPipeline{
+
+        private:
+            // buffers hold batch_size rows for the whole run; batch views the rows of the current batch, so the short
+            // last batch of an epoch reuses them like every other one
+            struct Slot{
+                TrainingBatch buffers;
+                TrainingBatch batch;
+            };
+
+            const std::vector<TrainingSample>& samples;
+            size_t batch_size;
+            int epochs;
+            uint64_t seed;
+            std::function<void(lin_alg::Matrix&)> normalize;
+
+            std::vector<Slot> ring;
+            size_t produced = 0;
+            size_t consumed = 0;
+            bool finished = false;
+            bool stopping = false;
+
+            std::mutex mutex;
+            std::condition_variable slot_filled;
+            std::condition_variable slot_freed;
+
+            PipelineStats stats;
+            std::exception_ptr producer_error;
+            std::thread producer;
+
+            void produce();
+            void fill_batch(Slot& slot, const std::vector<size_t>& order, size_t offset, size_t rows);
+
+        public:
+
+            /// @param seed The order of epoch e is drawn from stream (PipelineOrder, e) of this seed
+            /// @param normalize Applied in place to the inputs of every assembled batch. It runs once per batch on the
+            /// producer thread and must write into the slot's buffer rather than return a new matrix, so it allocates nothing
+            /// @param depth Number of ring buffers, 2 gives classic double buffering
+            BatchPipeline(const std::vector<TrainingSample>& samples, size_t batch_size, int epochs, uint64_t seed,
+                std::function<void(lin_alg::Matrix&)> normalize, size_t depth = 2);
+
+            ~BatchPipeline();
+
+            BatchPipeline(const BatchPipeline&) = delete;
+            BatchPipeline& operator=(const BatchPipeline&) = delete;
+
+            /// @brief Blocks until the next batch is ready
+            /// @return The batch, or nullptr once every epoch has been delivered
+            const TrainingBatch* acquire();
+
+            /// @brief Hands the batch returned by the last acquire() back to the producer
+            void release();
+
+            /// @brief The producer stage timings and the time the consumer spent waiting for input.
+            /// Only complete once acquire() has returned nullptr
+            PipelineStats get_stats();
+    };
+}
@@ -1,45 +1,53 @@
 #include "neural_network.h"
+#include "../diagnostics/trace.h"
 
 
 namespace neural_network{
     
-std::vector<TrainingBatch> NeuralNetwork::create_batches(const std::vector<TrainingSample>& training_data) {
-    std::vector<TrainingBatch> batches;
+void NeuralNetwork::check_dataset(const Dataset& data) const {
+    if (data.get_input_count() != get_input_size() || data.get_output_count() != get_output_size()) {
+        throw std::invalid_argument(std::format("Data set has {} inputs and {} outputs, the network takes {} and {}",
+            data.get_input_count(), data.get_output_count(), get_input_size(), get_output_size()));
+    }
+}
 
-    size_t offset = 0;
+std::vector<TrainingBatch> NeuralNetwork::create_batches(Dataset& training_data) const {
+    diagnostics::TraceSpan span("data", "create_batches");
+    check_dataset(training_data);
 
-    while (offset < training_data.size()) {
-        TrainingBatch batch = create_single_batch(training_data, offset);
-        batches.push_back(batch);
-        offset += batch.inputs.get_rows_count();
+    std::vector<TrainingBatch> batches;
+    const size_t rows = training_data.get_row_count();
+
+    for (size_t offset = 0; offset < rows; offset += batch_size) {
+        size_t remaining = rows - offset;
+        size_t curr_batch_size = remaining >= static_cast<size_t>(batch_size) ? batch_size : remaining;
+        batches.push_back(training_data.batch(offset, curr_batch_size));
     }
     return batches;
 }
 
-TrainingBatch NeuralNetwork::create_single_batch(const std::vector<TrainingSample>& training_data, size_t offset) {
-    size_t remaining = training_data.size() - offset;
-    size_t curr_batch_size = remaining >= batch_size ? batch_size : remaining;
+std::vector<TrainingBatch> NeuralNetwork::split_batch(TrainingBatch& batch, size_t shard_count) const {
+    diagnostics::TraceSpan span("data", "split_batch");
+    size_t rows = batch.inputs.get_rows_count();
+    if (shard_count > rows) shard_count = rows;
 
-    TrainingBatch batch(
-        lin_alg::Matrix(curr_batch_size, layers.front().get_weights().get_rows_count()),
-        lin_alg::Matrix(curr_batch_size, layers.back().get_biases().get_size())
-    );
-    // batch.inputs = lin_alg::Matrix(curr_batch_size, layers.front().get_weights().get_rows_count());
-    // batch.expected_outputs = lin_alg::Matrix(curr_batch_size, layers.back().get_biases().get_size());
+    const size_t input_cols = batch.inputs.get_cols_count();
+    const size_t output_cols = batch.expected_outputs.get_cols_count();
 
-    for (size_t i = 0; i < curr_batch_size; ++i) {
-        const TrainingSample& ts = training_data[offset + i];
+    std::vector<TrainingBatch> shards;
+    size_t offset = 0;
 
-        for (size_t c = 0; c < batch.inputs.get_cols_count(); ++c) {
-            batch.inputs(i, c) = ts.input_data[c];
-        }
+    for (size_t s = 0; s < shard_count; ++s) {
+        // the first (rows % shard_count) shards take one extra row
+        size_t shard_rows = rows / shard_count + (s < rows % shard_count ? 1 : 0);
 
-        for (size_t c = 0; c < batch.expected_outputs.get_cols_count(); ++c) {
-            batch.expected_outputs(i, c) = ts.expected_output[c];
-        }
+        shards.push_back(TrainingBatch(
+            lin_alg::Matrix::view(batch.inputs.get_data() + offset * input_cols, shard_rows, input_cols),
+            lin_alg::Matrix::view(batch.expected_outputs.get_data() + offset * output_cols, shard_rows, output_cols)
+        ));
+        offset += shard_rows;
     }
 
-    return batch;
+    return shards;
 }
 }
-
@@ -0,0 +1,206 @@
+#include "checkpoint.h"
+#include "../diagnostics/trace.h"
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <iterator>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace neural_network{
+
+    CheckpointWriter::CheckpointWriter(std::string path) : path(std::move(path)) {
+        worker = std::thread(&CheckpointWriter::run, this);
+    }
+
+    CheckpointWriter::~CheckpointWriter(){
+        finish();
+    }
+
+    void CheckpointWriter::submit(std::vector<char>& snapshot){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (has_pending) stats.superseded++;
+            std::swap(pending, snapshot);
+            has_pending = true;
+        }
+        pending_ready.notify_one();
+    }
+
+    CheckpointStats CheckpointWriter::finish(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        pending_ready.notify_one();
+        if (worker.joinable()) worker.join();
+        return stats;
+    }
+
+    void CheckpointWriter::run(){
+        diagnostics::set_trace_thread_name("checkpoint writer");
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true){
+            pending_ready.wait(lock, [this]{ return has_pending || stopping; });
+            if (!has_pending) return;
+
+            std::swap(pending, writing);
+            has_pending = false;
+            lock.unlock();
+
+            auto start = std::chrono::steady_clock::now();
+            std::string error;
+            try{
+                diagnostics::TraceSpan span("io", "write_checkpoint");
+                write_file(writing);
+            }
+            catch (const std::exception& e){
+                error = e.what();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            lock.lock();
+            stats.write_seconds += elapsed.count();
+            if (error.empty()){
+                stats.written++;
+                stats.bytes_written += writing.size();
+            }
+            else{
+                stats.failed++;
+                stats.last_error = error;
+            }
+        }
+    }
+
+    void CheckpointWriter::write_file(const std::vector<char>& bytes){
+        const std::string temp_path = path + ".tmp";
+
+        std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+        if (file == nullptr) throw std::runtime_error(std::format("Could not open checkpoint file for writing: {}", temp_path));
+
+        bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size() && std::fflush(file) == 0;
+
+        // the data has to be on disk before the rename makes it the current checkpoint
+        #ifdef _WIN32
+        ok = ok && _commit(_fileno(file)) == 0;
+        #else
+        ok = ok && fsync(fileno(file)) == 0;
+        #endif
+
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok) throw std::runtime_error(std::format("Could not write checkpoint file: {}", temp_path));
+
+        std::filesystem::rename(temp_path, path);
+    }
+
+    static void write_layers(ByteWriter& writer, const std::vector<NNLayer>& layers){
+        for (const NNLayer& layer : layers){
+            const lin_alg::Matrix& weights = layer.expose_weights();
+            writer.put<uint64_t>(weights.get_rows_count());
+            writer.put<uint64_t>(weights.get_cols_count());
+            writer.put_doubles(weights.get_data(), weights.get_rows_count() * weights.get_cols_count());
+            writer.put_doubles(layer.expose_biases().get_data(), layer.expose_biases().get_size());
+        }
+    }
+
+    static void read_layers(ByteReader& reader, std::vector<NNLayer>& layers){
+        for (size_t i = 0; i < layers.size(); i++){
+            lin_alg::Matrix& weights = layers[i].expose_weights();
+            uint64_t rows = reader.get<uint64_t>();
+            uint64_t cols = reader.get<uint64_t>();
+            if (rows != weights.get_rows_count() || cols != weights.get_cols_count()){
+                throw std::runtime_error(std::format("Checkpoint layer {} is {}x{}, the network layer is {}x{}",
+                    i, rows, cols, weights.get_rows_count(), weights.get_cols_count()));
+            }
+            reader.get_doubles(weights.get_data(), rows * cols);
+            reader.get_doubles(layers[i].expose_biases().get_data(), cols);
+        }
+    }
+
+    void NeuralNetwork::serialize_checkpoint(std::vector<char>& buffer, const TrainingProgress& progress,
+        const std::vector<NNLayer>* best_layers, const LearningRateSchedule& schedule) const{
+        buffer.clear();
+        ByteWriter writer(buffer);
+
+        writer.put_bytes(checkpoint_magic, sizeof(checkpoint_magic));
+        writer.put<uint32_t>(checkpoint_version);
+        writer.put<uint32_t>(static_cast<uint32_t>(layers.size()));
+
+        writer.put<int32_t>(progress.next_epoch);
+        writer.put<int32_t>(progress.best_epoch);
+        writer.put<double>(progress.best_validation_rmse);
+        writer.put<int32_t>(progress.evaluations_without_improvement);
+
+        writer.put<uint64_t>(seed);
+
+        write_layers(writer, layers);
+        writer.put<uint8_t>(best_layers != nullptr);
+        if (best_layers != nullptr) write_layers(writer, *best_layers);
+
+        std::vector<std::vector<double>> optimizer_state = optimizer->snapshot();
+        writer.put<uint64_t>(optimizer_state.size());
+        for (const std::vector<double>& values : optimizer_state){
+            writer.put_vector(values);
+        }
+
+        writer.put_vector(schedule.snapshot());
+    }
+
+    TrainingProgress NeuralNetwork::restore_checkpoint(const std::string& path, std::vector<NNLayer>& best_layers, LearningRateSchedule& schedule){
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) throw std::runtime_error(std::format("Could not open checkpoint: {}", path));
+        std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        ByteReader reader(bytes.data(), bytes.size());
+
+        char magic[sizeof(checkpoint_magic)];
+        reader.get_bytes(magic, sizeof(magic));
+        if (std::memcmp(magic, checkpoint_magic, sizeof(magic)) != 0) throw std::runtime_error(std::format("Not a checkpoint: {}", path));
+
+        uint32_t version = reader.get<uint32_t>();
+        if (version != checkpoint_version){
+            throw std::runtime_error(std::format("Unsupported checkpoint version {} in {}, expected {}", version, path, checkpoint_version));
+        }
+        uint32_t layer_count = reader.get<uint32_t>();
+        if (layer_count != layers.size()){
+            throw std::runtime_error(std::format("Checkpoint {} has {} layers, the network has {}", path, layer_count, layers.size()));
+        }
+
+        TrainingProgress progress;
+        progress.next_epoch = reader.get<int32_t>();
+        progress.best_epoch = reader.get<int32_t>();
+        progress.best_validation_rmse = reader.get<double>();
+        progress.evaluations_without_improvement = reader.get<int32_t>();
+
+        // parse everything before touching the network, so a corrupt checkpoint leaves it as it was
+        uint64_t restored_seed = reader.get<uint64_t>();
+
+        std::vector<NNLayer> restored_layers = layers;
+        read_layers(reader, restored_layers);
+
+        std::vector<NNLayer> restored_best = layers;
+        if (reader.get<uint8_t>() != 0) read_layers(reader, restored_best);
+
+        uint64_t buffer_count = reader.get<uint64_t>();
+        if (buffer_count > reader.remaining() / sizeof(uint64_t)) throw std::runtime_error("Checkpoint is truncated");
+        std::vector<std::vector<double>> optimizer_state(buffer_count);
+        for (std::vector<double>& values : optimizer_state){
+            values = reader.get_vector();
+        }
+        std::vector<double> schedule_state = reader.get_vector();
+
+        if (!reader.at_end()) throw std::runtime_error(std::format("Checkpoint {} has trailing data", path));
+
+        optimizer->restore(optimizer_state);
+        schedule.restore(schedule_state);
+        seed = restored_seed;
+        layers = std::move(restored_layers);
+        best_layers = std::move(restored_best);
+        return progress;
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <stdexcept>
+#include <format>
+#include <bit>
+#include "neural_network.h"
+
+namespace neural_network{
+
+    // Checkpoint file layout, all fields little-endian:
+    //   magic "NNCKPT\0\0", uint32 version, uint32 layer count
+    //   int32 next epoch, int32 best epoch, double best validation RMSE, int32 evaluations without improvement
+    //   uint64 seed - the epoch orders are drawn from it, so it replaces any RNG state
+    //   per layer: uint64 rows, uint64 cols, rows x cols weights, cols biases
+    //   uint8 has best layers, then the best layers like above
+    //   uint64 optimizer buffer count, per buffer: uint64 size and the values
+    //   uint64 schedule value count and the values
+    // Arrays are prefixed with their uint64 length.
+
+    static_assert(std::endian::native == std::endian::little, "Checkpoints are little-endian and written as-is");
+
+    constexpr char checkpoint_magic[8] = {'N', 'N', 'C', 'K', 'P', 'T', '\0', '\0'};
+    constexpr uint32_t checkpoint_version = 2;
+
+    /// @brief Appends plain values and arrays to a byte buffer. clear() keeps the capacity, so a reused buffer stops allocating
+    class ByteWriter{
+        private:
+            std::vector<char>& out;
+
+        public:
+            explicit ByteWriter(std::vector<char>& out) : out(out) {}
+
+            void put_bytes(const void* data, size_t size){
+                if (size == 0) return;
+                const size_t old_size = out.size();
+                out.resize(old_size + size);
+                std::memcpy(out.data() + old_size, data, size);
+            }
+
+            template <typename T>
+            void put(T value){
+                static_assert(std::is_trivially_copyable_v<T>);
+                put_bytes(&value, sizeof(T));
+            }
+
+            void put_doubles(const double* values, size_t count){
+                put_bytes(values, count * sizeof(double));
+            }
+
+            void put_vector(const std::vector<double>& values){
+                put<uint64_t>(values.size());
+                put_doubles(values.data(), values.size());
+            }
+    };
+
+    /// @brief Reads back what a ByteWriter wrote, throwing on truncated input
+    class ByteReader{
+        private:
+            const char* data;
+            size_t size;
+            size_t position = 0;
+
+        public:
+            ByteReader(const char* data, size_t size) : data(data), size(size) {}
+
+            void get_bytes(void* target, size_t count){
+                if (count > size - position) throw std::runtime_error("Checkpoint is truncated");
+                std::memcpy(target, data + position, count);
+                position += count;
+            }
+
+            template <typename T>
+            T get(){
+                static_assert(std::is_trivially_copyable_v<T>);
+                T value;
+                get_bytes(&value, sizeof(T));
+                return value;
+            }
+
+            void get_doubles(double* values, size_t count){
+                if (count > (size - position) / sizeof(double)) throw std::runtime_error("Checkpoint is truncated");
+                get_bytes(values, count * sizeof(double));
+            }
+
+            std::vector<double> get_vector(){
+                uint64_t count = get<uint64_t>();
+                if (count > (size - position) / sizeof(double)) throw std::runtime_error("Checkpoint is truncated");
+                std::vector<double> values(count);
+                get_doubles(values.data(), count);
+                return values;
+            }
+
+            size_t remaining() const { return size - position; }
+
+            bool at_end() const { return position == size; }
+    };
+
+    /// @brief Writes checkpoints on a background thread, so training never waits for the disk.
+    /// Every file is written to path + ".tmp" and renamed over path once complete, so path always holds a whole checkpoint.
+    /// If the previous checkpoint is still being written, a newer one replaces the one waiting in line
+    class CheckpointWriter{
+        private:
+            std::string path;
+
+            std::mutex mutex;
+            std::condition_variable pending_ready;
+            std::vector<char> pending;
+            std::vector<char> writing;
+            bool has_pending = false;
+            bool stopping = false;
+
+            CheckpointStats stats;
+
+            std::thread worker;
+
+            void run();
+            void write_file(const std::vector<char>& bytes);
+
+        public:
+            explicit CheckpointWriter(std::string path);
+
+            /// @brief Writes all queued checkpoints before returning
+            ~CheckpointWriter();
+
+            CheckpointWriter(const CheckpointWriter&) = delete;
+            CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+            /// @brief Queues a serialized checkpoint. The buffer is swapped with a spare one, so the caller
+            /// gets back an old buffer to serialize the next checkpoint into
+            void submit(std::vector<char>& snapshot);
+
+            /// @brief Waits for queued checkpoints and returns the statistics of all writes
+            CheckpointStats finish();
+    };
+}
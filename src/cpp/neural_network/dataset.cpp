@@ -0,0 +1,84 @@
+#include "dataset.h"
+#include <new>
+#include <algorithm>
+#include <stdexcept>
+#include <format>
+
+namespace neural_network{
+
+    static constexpr size_t dataset_alignment = 64;
+
+    static double* allocate_aligned(size_t count){
+        double* values = static_cast<double*>(::operator new[](count * sizeof(double), std::align_val_t(dataset_alignment)));
+        std::fill_n(values, count, 0.0);
+        return values;
+    }
+
+    void Dataset::AlignedDelete::operator()(double* values) const{
+        ::operator delete[](values, std::align_val_t(dataset_alignment));
+    }
+
+    size_t Dataset::targets_offset() const{
+        constexpr size_t per_line = dataset_alignment / sizeof(double);
+        return (rows * input_count + per_line - 1) / per_line * per_line;
+    }
+
+    static size_t checked_rows(size_t rows, size_t input_count, size_t output_count){
+        if (rows < 1 || input_count < 1 || output_count < 1){
+            throw std::invalid_argument(std::format("A data set needs at least one row, input and output. Given: {} rows, {} inputs, {} outputs",
+                rows, input_count, output_count));
+        }
+        return rows;
+    }
+
+    Dataset::Dataset(size_t rows, size_t input_count, size_t output_count)
+        : rows(checked_rows(rows, input_count, output_count)), input_count(input_count), output_count(output_count),
+          storage(allocate_aligned(targets_offset() + rows * output_count)),
+          features(lin_alg::Matrix::view(storage.get(), rows, input_count)),
+          targets(lin_alg::Matrix::view(storage.get() + targets_offset(), rows, output_count)) {}
+
+    Dataset::Dataset(const Dataset& other) : Dataset(other.rows, other.input_count, other.output_count) {
+        std::copy_n(other.storage.get(), targets_offset() + rows * output_count, storage.get());
+    }
+
+    Dataset Dataset::from_samples(const std::vector<TrainingSample>& samples){
+        if (samples.empty()) throw std::invalid_argument("A data set needs at least one sample");
+
+        Dataset data(samples.size(), samples.front().input_data.size(), samples.front().expected_output.size());
+        double* features = data.features.get_data();
+        double* targets = data.targets.get_data();
+
+        for (size_t r = 0; r < samples.size(); r++){
+            const TrainingSample& sample = samples[r];
+            if (sample.input_data.size() != data.input_count || sample.expected_output.size() != data.output_count){
+                throw std::invalid_argument(std::format("Sample {} has {} inputs and {} outputs, expected {} and {}",
+                    r, sample.input_data.size(), sample.expected_output.size(), data.input_count, data.output_count));
+            }
+            std::copy(sample.input_data.begin(), sample.input_data.end(), features + r * data.input_count);
+            std::copy(sample.expected_output.begin(), sample.expected_output.end(), targets + r * data.output_count);
+        }
+        return data;
+    }
+
+    std::vector<TrainingSample> Dataset::to_samples() const{
+        std::vector<TrainingSample> samples(rows);
+        const double* inputs = features.get_data();
+        const double* outputs = targets.get_data();
+
+        for (size_t r = 0; r < rows; r++){
+            samples[r].input_data.assign(inputs + r * input_count, inputs + (r + 1) * input_count);
+            samples[r].expected_output.assign(outputs + r * output_count, outputs + (r + 1) * output_count);
+        }
+        return samples;
+    }
+
+    TrainingBatch Dataset::batch(size_t offset, size_t count){
+        if (count == 0 || offset > rows || count > rows - offset){
+            throw std::out_of_range(std::format("Rows {}..{} are out of range for a data set of {} rows", offset, offset + count, rows));
+        }
+        return TrainingBatch(
+            lin_alg::Matrix::view(features.get_data() + offset * input_count, count, input_count),
+            lin_alg::Matrix::view(targets.get_data() + offset * output_count, count, output_count)
+        );
+    }
+}
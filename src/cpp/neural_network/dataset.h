@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include "../linear_algebra/lin_alg.h"
+
+namespace neural_network{
+
+    /// @brief Represents a single training sample for an iteration:
+    /// the inputs for each input neuron and the expected output for each output neuron
+    struct TrainingSample{
+        std::vector<double> input_data;
+        std::vector<double> expected_output;
+    };
+
+    struct TrainingBatch{
+        lin_alg::Matrix inputs;
+        lin_alg::Matrix expected_outputs;
+    };
+
+    /// @brief A whole data set in two contiguous, 64-byte aligned row-major matrices: one row of inputs and
+    /// one row of expected outputs per sample. Row ranges are handed out as batches that view the data set
+    /// instead of copying it, so they must not outlive it
+    class Dataset{
+        private:
+            struct AlignedDelete{
+                void operator()(double* values) const;
+            };
+
+            size_t rows;
+            size_t input_count;
+            size_t output_count;
+
+            // the inputs, then the outputs starting at the next 64-byte boundary
+            std::unique_ptr<double[], AlignedDelete> storage;
+
+            lin_alg::Matrix features;
+            lin_alg::Matrix targets;
+
+            size_t targets_offset() const;
+
+        public:
+            /// @brief A zero-filled data set
+            Dataset(size_t rows, size_t input_count, size_t output_count);
+
+            Dataset(const Dataset& other);
+            Dataset(Dataset&& other) noexcept = default;
+            Dataset& operator=(Dataset&& other) noexcept = default;
+
+            /// @brief Gathers samples into a data set; every sample must have the same number of inputs and outputs
+            static Dataset from_samples(const std::vector<TrainingSample>& samples);
+
+            std::vector<TrainingSample> to_samples() const;
+
+            size_t get_row_count() const { return rows; }
+            size_t get_input_count() const { return input_count; }
+            size_t get_output_count() const { return output_count; }
+
+            lin_alg::Matrix& get_features() { return features; }
+            const lin_alg::Matrix& get_features() const { return features; }
+            lin_alg::Matrix& get_targets() { return targets; }
+            const lin_alg::Matrix& get_targets() const { return targets; }
+
+            /// @brief Rows [offset, offset + count) as a batch of views into the data set
+            TrainingBatch batch(size_t offset, size_t count);
+    };
+}
@@ -1,11 +1,26 @@
 #include "neural_network.h"
-#include <random>
+#include <stdexcept>
+#include <format>
 
 namespace neural_network{
+
+    static ActivationKernel kernel_of(const std::shared_ptr<ActivationFunc>& act_func){
+        if (!act_func) throw std::invalid_argument("A layer needs an activation function");
+        return act_func->kernel();
+    }
+
         // Constructor initializes weights and biases
-        NNLayer::NNLayer(size_t input_size, size_t output_size, std::shared_ptr<ActivationFunc> act_func)
-        : weights(input_size, output_size), biases(output_size), activate_function(act_func) {
-        initialize_params();
+        NNLayer::NNLayer(size_t input_size, size_t output_size, std::shared_ptr<ActivationFunc> act_func, RandomStream init)
+        : weights(input_size, output_size), biases(output_size), activate_function(act_func), kernel(kernel_of(act_func)) {
+        initialize_params(init);
+    }
+
+    NNLayer::NNLayer(lin_alg::Matrix weights, lin_alg::Vector biases, std::shared_ptr<ActivationFunc> act_func)
+        : weights(std::move(weights)), biases(std::move(biases)), activate_function(act_func), kernel(kernel_of(act_func)) {
+        if (this->weights.get_cols_count() != this->biases.get_size()){
+            throw std::invalid_argument(std::format("Layer has {} outputs but {} biases",
+                this->weights.get_cols_count(), this->biases.get_size()));
+        }
     }
 
     std::shared_ptr<ActivationFunc> NNLayer::get_activation() const{
@@ -13,26 +28,21 @@ namespace neural_network{
     }
 
     // Randomly initializes weights and biases
-    void NNLayer::initialize_params() {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<> dist(-1.0, 1.0);
-
+    void NNLayer::initialize_params(RandomStream& stream) {
         for (size_t i = 0; i < weights.get_rows_count(); ++i)
             for (size_t j = 0; j < weights.get_cols_count(); ++j)
-                weights(i, j) = dist(gen);
+                weights(i, j) = stream.uniform(-1.0, 1.0);
                 // weights(i, j) = 0.1;
 
         for (size_t i = 0; i < biases.get_size(); ++i)
-            biases(i) = dist(gen);
+            biases(i) = stream.uniform(-1.0, 1.0);
             // biases(i) = 0.1;
     }
 
     // Forward pass through the layer
     lin_alg::Vector NNLayer::forward(const lin_alg::Vector& input) const{
         lin_alg::Vector z = (input * weights) + biases;
-        for (size_t i = 0; i < z.get_size(); ++i)
-            z(i) = (*activate_function).apply(z(i));
+        activate_function->apply_in_place(std::span<double>(z.get_data(), z.get_size()), z.get_size());
         return z;
     }
 
@@ -47,9 +57,8 @@ namespace neural_network{
                 output(r, c) = z(r, c);
             }
         }
-        std::function<double(double)> func = [&](double x) {return (*activate_function).apply(x);};
-        
-        output.apply_to_elements(func);
+        activate_function->apply_in_place(std::span<double>(output.get_data(), output.get_rows_count() * output.get_cols_count()),
+            output.get_cols_count());
 
         ForwardResult result{z, output};
         return result;
@@ -63,10 +72,19 @@ namespace neural_network{
         return this->biases;
     }
 
-    // Update weights and biases using gradients
-    void NNLayer::update(const lin_alg::Matrix& weight_grad, const lin_alg::Vector& bias_grad) {
-        weights += weight_grad;
-        biases += bias_grad;
+    const lin_alg::Matrix& NNLayer::expose_weights() const{
+        return this->weights;
+    }
+
+    const lin_alg::Vector& NNLayer::expose_biases() const{
+        return this->biases;
+    }
+
+    // Update weights and biases in place from their gradients
+    void NNLayer::update(Optimizer& optimizer, size_t layer_index, const LayerGradients& gradients, double learning_rate) {
+        optimizer.update(2 * layer_index, weights.get_data(), gradients.weights.get_data(),
+            weights.get_rows_count() * weights.get_cols_count(), learning_rate);
+        optimizer.update(2 * layer_index + 1, biases.get_data(), gradients.biases.get_data(), biases.get_size(), learning_rate);
     }
 
 
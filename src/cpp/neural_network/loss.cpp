@@ -0,0 +1,183 @@
+#include "loss.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <format>
+
+namespace neural_network{
+
+    static void check_shapes(const lin_alg::Matrix& values, const lin_alg::Matrix& expected){
+        if (values.get_rows_count() != expected.get_rows_count() || values.get_cols_count() != expected.get_cols_count()){
+            throw std::invalid_argument(std::format("Loss of a {}x{} batch against {}x{} targets", values.get_rows_count(),
+                values.get_cols_count(), expected.get_rows_count(), expected.get_cols_count()));
+        }
+    }
+
+    static size_t element_count(const lin_alg::Matrix& values){
+        return values.get_rows_count() * values.get_cols_count();
+    }
+
+    // the log of a probability, which cannot get below the smallest normal double
+    static double clamped_log(double p){
+        return std::log(std::max(p, std::numeric_limits<double>::min()));
+    }
+
+    double MeanSquaredError::value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const{
+        check_shapes(predicted, expected);
+        const double* p = predicted.get_data();
+        const double* y = expected.get_data();
+
+        double sum = 0;
+        for (size_t i = 0; i < element_count(predicted); i++){
+            sum += (p[i] - y[i]) * (p[i] - y[i]);
+        }
+        return sum;
+    }
+
+    double MeanSquaredError::gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const{
+        check_shapes(values, expected);
+        double* __restrict v = values.get_data();
+        const double* __restrict y = expected.get_data();
+        const size_t count = element_count(values);
+
+        double sum = 0;
+        for (size_t i = 0; i < count; i++){
+            v[i] -= y[i];
+            sum += v[i] * v[i];
+        }
+        return sum;
+    }
+
+    double MeanAbsoluteError::value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const{
+        check_shapes(predicted, expected);
+        const double* p = predicted.get_data();
+        const double* y = expected.get_data();
+
+        double sum = 0;
+        for (size_t i = 0; i < element_count(predicted); i++){
+            sum += std::abs(p[i] - y[i]);
+        }
+        return sum;
+    }
+
+    double MeanAbsoluteError::gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const{
+        check_shapes(values, expected);
+        double* __restrict v = values.get_data();
+        const double* __restrict y = expected.get_data();
+        const size_t count = element_count(values);
+
+        double sum = 0;
+        for (size_t i = 0; i < count; i++){
+            const double r = v[i] - y[i];
+            sum += std::abs(r);
+            v[i] = static_cast<double>(r > 0) - static_cast<double>(r < 0);
+        }
+        return sum;
+    }
+
+    Huber::Huber(double delta) : delta(delta){
+        if (!(delta > 0)) throw std::invalid_argument(std::format("Huber delta must be > 0, got {}", delta));
+    }
+
+    double Huber::value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const{
+        check_shapes(predicted, expected);
+        const double* p = predicted.get_data();
+        const double* y = expected.get_data();
+
+        double sum = 0;
+        for (size_t i = 0; i < element_count(predicted); i++){
+            const double a = std::abs(p[i] - y[i]);
+            sum += a <= delta ? 0.5 * a * a : delta * (a - 0.5 * delta);
+        }
+        return sum;
+    }
+
+    double Huber::gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const{
+        check_shapes(values, expected);
+        double* __restrict v = values.get_data();
+        const double* __restrict y = expected.get_data();
+        const size_t count = element_count(values);
+
+        double sum = 0;
+        for (size_t i = 0; i < count; i++){
+            const double r = v[i] - y[i];
+            // the clipped residual c gives both: 0.5 r^2 inside the band, and delta |r| - 0.5 delta^2 = c r - 0.5 c^2 outside
+            const double c = std::clamp(r, -delta, delta);
+            sum += c * r - 0.5 * c * c;
+            v[i] = c;
+        }
+        return sum;
+    }
+
+    double BinaryCrossEntropy::value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const{
+        check_shapes(predicted, expected);
+        const double* p = predicted.get_data();
+        const double* y = expected.get_data();
+
+        double sum = 0;
+        for (size_t i = 0; i < element_count(predicted); i++){
+            sum -= y[i] * clamped_log(p[i]) + (1 - y[i]) * clamped_log(1 - p[i]);
+        }
+        return sum;
+    }
+
+    double BinaryCrossEntropy::gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const{
+        check_shapes(values, expected);
+        double* __restrict z = values.get_data();
+        const double* __restrict y = expected.get_data();
+        const size_t count = element_count(values);
+
+        double sum = 0;
+        for (size_t i = 0; i < count; i++){
+            // a single exp serves the loss and the sigmoid: e = e^-|z|, sigmoid(z) = 1 / (1 + e) for z >= 0 and e / (1 + e) below
+            const double e = std::exp(-std::abs(z[i]));
+            sum += std::max(z[i], 0.0) - y[i] * z[i] + std::log1p(e);
+            const double p = (z[i] >= 0 ? 1.0 : e) / (1 + e);
+            z[i] = p - y[i];
+        }
+        return sum;
+    }
+
+    double SoftmaxCrossEntropy::value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const{
+        check_shapes(predicted, expected);
+        const double* p = predicted.get_data();
+        const double* y = expected.get_data();
+
+        double sum = 0;
+        for (size_t i = 0; i < element_count(predicted); i++){
+            if (y[i] != 0) sum -= y[i] * clamped_log(p[i]);
+        }
+        return sum;
+    }
+
+    double SoftmaxCrossEntropy::gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const{
+        check_shapes(values, expected);
+        const size_t cols = values.get_cols_count();
+
+        double sum = 0;
+        for (size_t r = 0; r < values.get_rows_count(); r++){
+            double* __restrict z = values.get_data() + r * cols;
+            const double* __restrict y = expected.get_data() + r * cols;
+
+            double max = z[0];
+            for (size_t c = 1; c < cols; c++) max = std::max(max, z[c]);
+
+            // -sum_c y_c log p_c = sum_c y_c (logsumexp(z) - z_c); the shifted exponentials are kept for p
+            double exp_sum = 0;
+            double target_sum = 0;
+            double target_dot = 0;
+            for (size_t c = 0; c < cols; c++){
+                target_sum += y[c];
+                target_dot += y[c] * (z[c] - max);
+                z[c] = std::exp(z[c] - max);
+                exp_sum += z[c];
+            }
+            sum += target_sum * std::log(exp_sum) - target_dot;
+
+            const double scale = target_sum / exp_sum;
+            for (size_t c = 0; c < cols; c++) z[c] = z[c] * scale - y[c];
+        }
+        return sum;
+    }
+}
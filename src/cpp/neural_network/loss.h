@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include "../linear_algebra/lin_alg.h"
+#include "activation_funcs.h"
+
+namespace neural_network{
+
+    /// @brief Scores a batch of network outputs against its targets and turns them into the gradient the backward pass starts from.
+    /// The loss value and the gradient come out of one pass over the batch, the gradient is written over the outputs' copy
+    class Loss{
+        public:
+            virtual ~Loss() = default;
+
+            /// @brief Summed loss of a batch of outputs of the last layer
+            virtual double value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const = 0;
+
+            /// @brief Replaces values by the loss gradient and returns the summed loss of the batch.
+            /// values holds the outputs of the last layer on entry, or its pre-activations (logits) when the loss is fused
+            /// with the output activation; the gradient is then taken with respect to the logits
+            virtual double gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const = 0;
+
+            /// @brief The output activation the loss is fused with, nullopt when it works on any output.
+            /// A fused loss folds the activation's derivative into its gradient, so the backward pass skips it
+            virtual std::optional<ActivationId> fused_activation() const { return std::nullopt; }
+
+            /// @brief Number of terms the summed loss of a rows x cols batch averages over - one per output by default
+            virtual size_t term_count(size_t rows, size_t cols) const { return rows * cols; }
+    };
+
+    /// @brief Squared error (p - y)^2. The gradient is p - y, the one of half the squared error,
+    /// which is what training has always used, so existing learning rates carry over
+    class MeanSquaredError : public Loss{
+        public:
+            double value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const override;
+            double gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const override;
+    };
+
+    /// @brief Absolute error |p - y|, with the gradient sign(p - y)
+    class MeanAbsoluteError : public Loss{
+        public:
+            double value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const override;
+            double gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const override;
+    };
+
+    /// @brief 0.5 r^2 for |r| <= delta and delta (|r| - 0.5 delta) beyond, r = p - y: squared error near the target,
+    /// absolute error for outliers. The gradient is r clipped to [-delta, delta]
+    class Huber : public Loss{
+        private:
+            double delta;
+
+        public:
+            explicit Huber(double delta = 1.0);
+
+            double value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const override;
+            double gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const override;
+    };
+
+    /// @brief -(y log p + (1 - y) log(1 - p)) for every output, fused with a Sigmoid output layer.
+    /// It works on the logits z: the loss is max(z, 0) - y z + log(1 + e^-|z|), which never takes the log of 0,
+    /// and the gradient is sigmoid(z) - y
+    class BinaryCrossEntropy : public Loss{
+        public:
+            double value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const override;
+            double gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const override;
+            std::optional<ActivationId> fused_activation() const override { return ActivationId::Sigmoid; }
+    };
+
+    /// @brief -sum_c y_c log p_c over every row, fused with a Softmax output layer. It works on the logits z through
+    /// log p_c = z_c - logsumexp(z), with the row maximum taken out before exponentiating; the gradient is p - y
+    /// (sum_c y_c p - y for targets that are not normalized). The mean is per row, not per output
+    class SoftmaxCrossEntropy : public Loss{
+        public:
+            double value(const lin_alg::Matrix& predicted, const lin_alg::Matrix& expected) const override;
+            double gradient(lin_alg::Matrix& values, const lin_alg::Matrix& expected) const override;
+            std::optional<ActivationId> fused_activation() const override { return ActivationId::Softmax; }
+            size_t term_count(size_t rows, size_t) const override { return rows; }
+    };
+}
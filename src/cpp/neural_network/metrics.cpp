@@ -0,0 +1,121 @@
+#include "metrics.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace neural_network{
+
+    // the block loops keep `lanes` independent partial sums, which the compiler maps onto SIMD registers
+    // without having to reorder floating point additions
+    static constexpr size_t lanes = 4;
+    static constexpr size_t block_size = 256;
+
+    void MetricAccumulator::add(double predicted, double target){
+        add_block(&predicted, &target, 1);
+    }
+
+    void MetricAccumulator::add(const lin_alg::Matrix& predicted, const lin_alg::Matrix& target){
+        if (predicted.get_rows_count() != target.get_rows_count() || predicted.get_cols_count() != target.get_cols_count()){
+            throw std::invalid_argument("Predictions and targets must have the same number of elements");
+        }
+
+        const size_t elements = predicted.get_rows_count() * predicted.get_cols_count();
+        for (size_t offset = 0; offset < elements; offset += block_size){
+            add_block(predicted.get_data() + offset, target.get_data() + offset, std::min(block_size, elements - offset));
+        }
+    }
+
+    void MetricAccumulator::add_block(const double* predicted, const double* target, size_t n){
+        const size_t vector_end = n / lanes * lanes;
+
+        double sum_p[lanes] = {}, sum_t[lanes] = {};
+        for (size_t i = 0; i < vector_end; i += lanes){
+            for (size_t l = 0; l < lanes; l++){
+                sum_p[l] += predicted[i + l];
+                sum_t[l] += target[i + l];
+            }
+        }
+        double total_p = 0, total_t = 0;
+        for (size_t l = 0; l < lanes; l++){
+            total_p += sum_p[l];
+            total_t += sum_t[l];
+        }
+        for (size_t i = vector_end; i < n; i++){
+            total_p += predicted[i];
+            total_t += target[i];
+        }
+
+        MetricAccumulator block;
+        block.count = n;
+        block.mean_predicted = total_p / n;
+        block.mean_target = total_t / n;
+
+        double m2_p[lanes] = {}, m2_t[lanes] = {}, co[lanes] = {}, se[lanes] = {}, ae[lanes] = {};
+        for (size_t i = 0; i < vector_end; i += lanes){
+            for (size_t l = 0; l < lanes; l++){
+                const double dp = predicted[i + l] - block.mean_predicted;
+                const double dt = target[i + l] - block.mean_target;
+                const double error = predicted[i + l] - target[i + l];
+                m2_p[l] += dp * dp;
+                m2_t[l] += dt * dt;
+                co[l] += dp * dt;
+                se[l] += error * error;
+                ae[l] += std::abs(error);
+            }
+        }
+        for (size_t l = 0; l < lanes; l++){
+            block.m2_predicted += m2_p[l];
+            block.m2_target += m2_t[l];
+            block.co_moment += co[l];
+            block.squared_error += se[l];
+            block.absolute_error += ae[l];
+        }
+        for (size_t i = vector_end; i < n; i++){
+            const double dp = predicted[i] - block.mean_predicted;
+            const double dt = target[i] - block.mean_target;
+            const double error = predicted[i] - target[i];
+            block.m2_predicted += dp * dp;
+            block.m2_target += dt * dt;
+            block.co_moment += dp * dt;
+            block.squared_error += error * error;
+            block.absolute_error += std::abs(error);
+        }
+
+        merge(block);
+    }
+
+    void MetricAccumulator::merge(const MetricAccumulator& other){
+        if (other.count == 0) return;
+        if (count == 0){
+            *this = other;
+            return;
+        }
+
+        const double n_a = static_cast<double>(count);
+        const double n_b = static_cast<double>(other.count);
+        const double n = n_a + n_b;
+        const double delta_p = other.mean_predicted - mean_predicted;
+        const double delta_t = other.mean_target - mean_target;
+
+        mean_predicted += delta_p * n_b / n;
+        mean_target += delta_t * n_b / n;
+        m2_predicted += other.m2_predicted + delta_p * delta_p * n_a * n_b / n;
+        m2_target += other.m2_target + delta_t * delta_t * n_a * n_b / n;
+        co_moment += other.co_moment + delta_p * delta_t * n_a * n_b / n;
+        squared_error += other.squared_error;
+        absolute_error += other.absolute_error;
+        count += other.count;
+    }
+
+    RegressionMetrics MetricAccumulator::get_metrics() const{
+        RegressionMetrics metrics;
+        metrics.count = count;
+        if (count == 0) return metrics;
+
+        metrics.rmse = std::sqrt(squared_error / count);
+        metrics.mae = absolute_error / count;
+        metrics.r_squared = m2_target > 0 ? 1 - squared_error / m2_target : 0;
+        metrics.pearson = m2_predicted > 0 && m2_target > 0 ? co_moment / (std::sqrt(m2_predicted) * std::sqrt(m2_target)) : 0;
+        return metrics;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include "../linear_algebra/lin_alg.h"
+
+namespace neural_network{
+
+    /// @brief Regression quality of a set of predictions, every output column pooled together
+    struct RegressionMetrics{
+        size_t count = 0;
+        double rmse = 0;
+        double mae = 0;
+        double r_squared = 0;   // 1 - SSE / total sum of squares of the targets, 0 for constant targets
+        double pearson = 0;     // 0 when the predictions or the targets are constant
+    };
+
+    /// @brief Accumulates prediction/target pairs in a single pass with O(1) memory. Means and (co)moments are kept in
+    /// centered form (Welford) instead of raw sums of squares, so R² and Pearson stay accurate for large or offset values.
+    /// Two accumulators over disjoint data merge exactly (Chan et al.), which lets every thread own one
+    class MetricAccumulator{
+        private:
+            size_t count = 0;
+            double mean_predicted = 0;
+            double mean_target = 0;
+            double m2_predicted = 0;        // sum of squared deviations from mean_predicted
+            double m2_target = 0;
+            double co_moment = 0;           // sum of (predicted - mean_predicted) * (target - mean_target)
+            double squared_error = 0;
+            double absolute_error = 0;
+
+            /// @brief Adds a block of pairs: exact two-pass moments over the block, then one merge
+            void add_block(const double* predicted, const double* target, size_t count);
+
+        public:
+            void add(double predicted, double target);
+
+            /// @brief Adds every element of a prediction batch and the matching target batch
+            void add(const lin_alg::Matrix& predicted, const lin_alg::Matrix& target);
+
+            void merge(const MetricAccumulator& other);
+
+            size_t get_count() const { return count; }
+            RegressionMetrics get_metrics() const;
+    };
+}
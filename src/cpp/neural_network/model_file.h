@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+
+namespace neural_network{
+
+    // Binary model file layout, all fields little-endian:
+    //   ModelHeader                                     at offset 0
+    //   layer_count LayerRecords                         at layers_offset
+    //   input_size input shifts, input_size input scales, output_size output scales (doubles)      at normalization_offset
+    //   per layer: input_size x output_size row-major weights, then output_size biases (doubles)
+    // Every block starts at a multiple of model_alignment, so once the file is mapped the weights can be used in place.
+    // Readers reject files with a different magic or a version they do not know.
+    // Version 1 files have no input shifts: the normalization block starts with the input scales.
+
+    static_assert(std::endian::native == std::endian::little, "Model files are little-endian and mapped as-is");
+
+    constexpr char model_magic[8] = {'N', 'N', 'M', 'O', 'D', 'E', 'L', '\0'};
+    constexpr uint32_t model_version = 2;
+    constexpr size_t model_alignment = 64;
+
+    struct ModelHeader{
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint32_t layer_count;
+        uint32_t input_size;
+        uint32_t output_size;
+        uint32_t normalization;     // NormalizationKind, 0 in version 1 files
+        uint64_t layers_offset;
+        uint64_t normalization_offset;
+        uint64_t file_size;
+        uint64_t reserved_tail;
+    };
+
+    struct LayerRecord{
+        uint32_t input_size;
+        uint32_t output_size;
+        uint32_t activation;    // ActivationId
+        uint32_t reserved;
+        uint64_t weights_offset;
+        uint64_t biases_offset;
+    };
+
+    static_assert(sizeof(ModelHeader) == 64 && sizeof(LayerRecord) == 32, "Model file records must not contain padding");
+
+    /// @brief Rounds offset up to the next multiple of model_alignment
+    constexpr uint64_t align_model_offset(uint64_t offset){
+        return (offset + model_alignment - 1) / model_alignment * model_alignment;
+    }
+}
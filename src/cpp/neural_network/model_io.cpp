@@ -0,0 +1,161 @@
+#include "neural_network.h"
+#include "model_file.h"
+#include "../file/mapped_file.h"
+#include <fstream>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+
+namespace neural_network {
+
+    static void write_padding(std::ofstream& out, uint64_t& offset, uint64_t target){
+        static const char zeros[model_alignment] = {};
+        out.write(zeros, static_cast<std::streamsize>(target - offset));
+        offset = target;
+    }
+
+    static void write_doubles(std::ofstream& out, uint64_t& offset, const double* values, size_t count){
+        out.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(count * sizeof(double)));
+        offset += count * sizeof(double);
+    }
+
+    void NeuralNetwork::save(const std::string& path) const{
+        ModelHeader header{};
+        std::memcpy(header.magic, model_magic, sizeof(model_magic));
+        header.version = model_version;
+        header.header_size = sizeof(ModelHeader);
+        header.layer_count = static_cast<uint32_t>(layers.size());
+        header.input_size = static_cast<uint32_t>(get_input_size());
+        header.output_size = static_cast<uint32_t>(get_output_size());
+        header.normalization = static_cast<uint32_t>(input_normalizer.get_kind());
+        header.layers_offset = align_model_offset(sizeof(ModelHeader));
+        header.normalization_offset = align_model_offset(header.layers_offset + layers.size() * sizeof(LayerRecord));
+
+        // lay out the weight blocks behind the normalization parameters
+        std::vector<LayerRecord> records(layers.size());
+        uint64_t end = header.normalization_offset + (2 * get_input_size() + output_scales.size()) * sizeof(double);
+        for (size_t i = 0; i < layers.size(); i++){
+            const lin_alg::Matrix& weights = layers[i].expose_weights();
+            LayerRecord& record = records[i];
+            record.input_size = static_cast<uint32_t>(weights.get_rows_count());
+            record.output_size = static_cast<uint32_t>(weights.get_cols_count());
+            record.activation = static_cast<uint32_t>(layers[i].get_activation()->get_id());
+            record.weights_offset = align_model_offset(end);
+            record.biases_offset = align_model_offset(record.weights_offset + weights.get_rows_count() * weights.get_cols_count() * sizeof(double));
+            end = record.biases_offset + weights.get_cols_count() * sizeof(double);
+        }
+        header.file_size = end;
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) throw std::runtime_error(std::format("Could not open model file for writing: {}", path));
+
+        uint64_t offset = 0;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        offset += sizeof(header);
+
+        write_padding(out, offset, header.layers_offset);
+        out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(LayerRecord)));
+        offset += records.size() * sizeof(LayerRecord);
+
+        write_padding(out, offset, header.normalization_offset);
+        write_doubles(out, offset, input_normalizer.get_shifts().data(), get_input_size());
+        write_doubles(out, offset, input_normalizer.get_scales().data(), get_input_size());
+        write_doubles(out, offset, output_scales.data(), output_scales.size());
+
+        for (size_t i = 0; i < layers.size(); i++){
+            const lin_alg::Matrix& weights = layers[i].expose_weights();
+            write_padding(out, offset, records[i].weights_offset);
+            write_doubles(out, offset, weights.get_data(), weights.get_rows_count() * weights.get_cols_count());
+            write_padding(out, offset, records[i].biases_offset);
+            write_doubles(out, offset, layers[i].expose_biases().get_data(), weights.get_cols_count());
+        }
+
+        out.flush();
+        if (!out) throw std::runtime_error(std::format("Could not write model file: {}", path));
+    }
+
+    // Checks that count doubles at offset lie inside the file and are aligned to model_alignment
+    static void validate_block(const std::string& path, uint64_t file_size, uint64_t offset, uint64_t count, const char* what){
+        if (offset % model_alignment != 0){
+            throw std::runtime_error(std::format("Corrupt model file {}: {} at offset {} is not {}-byte aligned", path, what, offset, model_alignment));
+        }
+        if (offset > file_size || count > (file_size - offset) / sizeof(double)){
+            throw std::runtime_error(std::format("Corrupt model file {}: {} extends past the end of the file", path, what));
+        }
+    }
+
+    NeuralNetwork NeuralNetwork::load(const std::string& path, int batch_size){
+        std::shared_ptr<file_handling::MappedFile> mapping = std::make_shared<file_handling::MappedFile>(path);
+        std::byte* base = mapping->get_data();
+        const uint64_t file_size = mapping->get_size();
+
+        if (file_size < sizeof(ModelHeader)) throw std::runtime_error(std::format("Not a model file: {}", path));
+
+        ModelHeader header;
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, model_magic, sizeof(model_magic)) != 0){
+            throw std::runtime_error(std::format("Not a model file: {}", path));
+        }
+        if (header.version != model_version && header.version != 1){
+            throw std::runtime_error(std::format("Unsupported model file version {} in {}, expected {}", header.version, path, model_version));
+        }
+        if (header.header_size != sizeof(ModelHeader) || header.file_size != file_size || header.layer_count == 0){
+            throw std::runtime_error(std::format("Corrupt model file {}: inconsistent header", path));
+        }
+        if (header.layers_offset % alignof(LayerRecord) != 0 || header.layers_offset > file_size
+            || header.layer_count > (file_size - header.layers_offset) / sizeof(LayerRecord)){
+            throw std::runtime_error(std::format("Corrupt model file {}: layer table extends past the end of the file", path));
+        }
+        const bool has_shifts = header.version >= 2;
+        validate_block(path, file_size, header.normalization_offset, uint64_t(header.input_size) * (has_shifts ? 2 : 1) + header.output_size,
+            "normalization parameters");
+
+        std::vector<LayerRecord> records(header.layer_count);
+        std::memcpy(records.data(), base + header.layers_offset, records.size() * sizeof(LayerRecord));
+
+        std::vector<NNLayer> layers;
+        for (size_t i = 0; i < records.size(); i++){
+            const LayerRecord& record = records[i];
+            validate_block(path, file_size, record.weights_offset, uint64_t(record.input_size) * record.output_size, "weights");
+            validate_block(path, file_size, record.biases_offset, record.output_size, "biases");
+            if (record.input_size == 0 || record.output_size == 0){
+                throw std::runtime_error(std::format("Corrupt model file {}: layer {} is empty", path, i));
+            }
+            if (i + 1 < records.size() && record.output_size != records[i + 1].input_size){
+                throw std::runtime_error(std::format("Corrupt model file {}: layer {} has {} outputs, the next layer takes {} inputs",
+                    path, i, record.output_size, records[i + 1].input_size));
+            }
+
+            // the layers point straight into the mapping, nothing is copied
+            double* weights = reinterpret_cast<double*>(base + record.weights_offset);
+            double* biases = reinterpret_cast<double*>(base + record.biases_offset);
+            layers.push_back(NNLayer(lin_alg::Matrix::view(weights, record.input_size, record.output_size),
+                lin_alg::Vector::view(biases, record.output_size), make_activation(static_cast<ActivationId>(record.activation))));
+        }
+        if (layers.front().expose_weights().get_rows_count() != header.input_size
+            || layers.back().expose_biases().get_size() != header.output_size){
+            throw std::runtime_error(std::format("Corrupt model file {}: layer sizes do not match the header", path));
+        }
+
+        NeuralNetwork network(std::move(layers), batch_size, random_seed());
+
+        const double* normalization = reinterpret_cast<const double*>(base + header.normalization_offset);
+        const double* input_scales = has_shifts ? normalization + header.input_size : normalization;
+        std::vector<double> shifts = has_shifts ? std::vector<double>(normalization, input_scales) : std::vector<double>(header.input_size, 0.0);
+        NormalizationKind kind = has_shifts ? static_cast<NormalizationKind>(header.normalization) : NormalizationKind::Scale;
+        if (kind > NormalizationKind::Standard) throw std::runtime_error(std::format("Corrupt model file {}: unknown normalization {}", path, header.normalization));
+        try{
+            network.input_normalizer = Normalizer(kind, std::move(shifts), std::vector<double>(input_scales, input_scales + header.input_size));
+        }
+        catch (const std::invalid_argument& e){
+            throw std::runtime_error(std::format("Corrupt model file {}: {}", path, e.what()));
+        }
+
+        const double* output_scales = input_scales + header.input_size;
+        network.output_scales.assign(output_scales, output_scales + header.output_size);
+
+        network.model_mapping = mapping;
+        return network;
+    }
+
+}
@@ -1,93 +1,253 @@
 #include "neural_network.h"
+#include "batch_pipeline.h"
+#include "checkpoint.h"
+#include "../diagnostics/trace.h"
 #include <iostream>
 #include <random>
 #include <cmath>
 #include <algorithm>
 #include <cassert>
 #include <format>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <iterator>
+
+static constexpr size_t predict_block_rows = 256;
+// rows one evaluation task predicts and scores at a time
+static constexpr size_t evaluate_chunk_rows = 16 * predict_block_rows;
 
 #define assertm(exp, msg) assert((void(msg), exp))
 
 namespace neural_network {
 
-    NeuralNetwork::NeuralNetwork(int batch_size) : batch_size(batch_size) {
+    // the ScopedPhase slot of a training phase, empty when no telemetry is recorded
+    static diagnostics::PhaseSlot phase_slot(diagnostics::TrainingTelemetry* telemetry, diagnostics::Phase phase){
+        return telemetry ? telemetry->phase(phase) : diagnostics::PhaseSlot{};
+    }
+
+    static std::vector<LayerSpec> default_topology(){
         std::shared_ptr<ActivationFunc> sigmoid = std::make_shared<Sigmoid>();
-            std::shared_ptr<ActivationFunc> relu = std::make_shared<ReLU>();
 
-            //register input layer
-            layers.push_back(NNLayer(4, 10, sigmoid));
-            
-            //hidden layers
-            layers.push_back(NNLayer(10, 6, sigmoid));
-        
-            //output layer
-            layers.push_back(NNLayer(6, 1, sigmoid));
-    }
-
-    lin_alg::Vector NeuralNetwork::normalize_input(const lin_alg::Vector& input) const {
-        lin_alg::Vector normalized(input.get_size());
-    
-        // Normalize the first input (0 to 30)
-        normalized(0) = input(0) /30;
-    
-        // Normalize the second input (0 to 10)
-        normalized(1) = input(1) / 10;
-    
-        // Normalize the third input (0 to 30)
-        normalized(2) = input(2) / 30;
-    
-        // Normalize the fourth input (0 to 10)
-        normalized(3) = input(3) / 10;
-    
-        return normalized;
-    }
-    
-    // Function to normalize an entire matrix of inputs (by rows)
-    lin_alg::Matrix NeuralNetwork::normalize_inputs(const lin_alg::Matrix& inputs) const {
-        lin_alg::Matrix normalized(inputs.get_rows_count(), inputs.get_cols_count());
-
-        for (size_t i = 0; i < inputs.get_rows_count(); ++i) {
-            lin_alg::Vector input_row = lin_alg::Vector::from_matrix_row(inputs, i);
-            lin_alg::Vector normalized_row = normalize_input(input_row);  // Use the previously defined normalize_input function
-            
-            for (size_t j = 0; j < normalized_row.get_size(); ++j) {
-                normalized(i, j) = normalized_row(j);
+        return {
+            {4, 10, sigmoid},   //input layer
+            {10, 6, sigmoid},   //hidden layers
+            {6, 1, sigmoid}     //output layer
+        };
+    }
+
+    NeuralNetwork::NeuralNetwork(int batch_size, uint64_t seed) : NeuralNetwork(batch_size, default_topology(), seed) {
+        // Ranges of the four inputs: the first and third go from 0 to 30, the second and fourth from 0 to 10
+        input_normalizer = Normalizer::scaling({30, 10, 30, 10});
+    }
+
+    static std::vector<NNLayer> create_layers(const std::vector<LayerSpec>& topology, uint64_t seed){
+        std::vector<NNLayer> layers;
+        for (size_t i = 0; i < topology.size(); i++){
+            const LayerSpec& spec = topology[i];
+            if (!spec.activation) throw std::invalid_argument(std::format("Layer {} has no activation function", i));
+            layers.push_back(NNLayer(spec.input_size, spec.output_size, spec.activation,
+                RandomStream(seed, RandomStreamKind::LayerInit, static_cast<uint32_t>(i))));
+        }
+        return layers;
+    }
+
+    NeuralNetwork::NeuralNetwork(int batch_size, const std::vector<LayerSpec>& topology, uint64_t seed)
+        : NeuralNetwork(create_layers(topology, seed), batch_size, seed) {
+    }
+
+    NeuralNetwork::NeuralNetwork(std::vector<NNLayer> layers, int batch_size, uint64_t seed)
+        : layers(std::move(layers)), batch_size(batch_size), optimizer(std::make_shared<SGD>()),
+          loss(std::make_shared<MeanSquaredError>()), seed(seed) {
+        if (this->layers.empty()) throw std::invalid_argument("A network needs at least one layer");
+
+        for (size_t i = 1; i < this->layers.size(); i++){
+            const size_t inputs = this->layers[i].expose_weights().get_rows_count();
+            const size_t previous_outputs = this->layers[i - 1].expose_weights().get_cols_count();
+            if (inputs != previous_outputs){
+                throw std::invalid_argument(std::format("Layer {} expects {} inputs but the previous layer has {} outputs",
+                    i, inputs, previous_outputs));
+            }
+        }
+
+        input_normalizer = Normalizer(get_input_size());
+        output_scales.assign(get_output_size(), 1.0);
+    }
+
+    static size_t matrix_bytes(const lin_alg::Matrix& m){
+        return m.get_rows_count() * m.get_cols_count() * sizeof(double);
+    }
+
+    // a rows x cols matrix in buffer's memory. The buffer only grows when it is too small, smaller batches view its first rows
+    static lin_alg::Matrix workspace(std::optional<lin_alg::Matrix>& buffer, size_t rows, size_t cols){
+        if (rows * cols == 0) return lin_alg::Matrix(rows, cols);
+        if (!buffer || buffer->get_rows_count() * buffer->get_cols_count() < rows * cols) buffer.emplace(rows, cols);
+        return lin_alg::Matrix::view(buffer->get_data(), rows, cols);
+    }
+
+    void NeuralNetwork::set_activation_checkpointing(size_t every_k_layers){
+        if (every_k_layers == 0) throw std::invalid_argument("Checkpoint interval must be >= 1");
+        checkpoint_every = every_k_layers;
+    }
+
+    ActivationMemoryStats NeuralNetwork::get_activation_stats() const{
+        return context.stats;
+    }
+
+    void NeuralNetwork::set_optimizer(std::shared_ptr<Optimizer> optimizer){
+        if (!optimizer) throw std::invalid_argument("Optimizer must not be null");
+        this->optimizer = optimizer;
+    }
+
+    void NeuralNetwork::set_loss(std::shared_ptr<Loss> loss){
+        if (!loss) throw std::invalid_argument("Loss must not be null");
+
+        std::optional<ActivationId> fused = loss->fused_activation();
+        ActivationId output_activation = layers.back().get_activation()->get_id();
+        if (fused && *fused != output_activation){
+            throw std::invalid_argument(std::format("The loss needs an output layer with activation {}, the network's has {}",
+                static_cast<uint32_t>(*fused), static_cast<uint32_t>(output_activation)));
+        }
+        this->loss = loss;
+    }
+
+    void NeuralNetwork::fit_normalizer(const Dataset& data, NormalizationKind kind, size_t threads) {
+        check_dataset(data);
+        input_normalizer = Normalizer::fit(data, kind, threads);
+    }
+
+    void NeuralNetwork::set_normalizer(Normalizer normalizer) {
+        if (normalizer.get_feature_count() != get_input_size()) {
+            throw std::invalid_argument(std::format("Normalizer covers {} features, the network has {} inputs",
+                normalizer.get_feature_count(), get_input_size()));
+        }
+        input_normalizer = std::move(normalizer);
+    }
+
+    void NeuralNetwork::normalize(Dataset& data) const {
+        check_dataset(data);
+        input_normalizer.apply(data.get_features());
+    }
+
+    void NeuralNetwork::fold_normalizer() {
+        if (input_normalizer.is_identity()) return;
+
+        const NNLayer& first = layers.front();
+        const lin_alg::Matrix& weights = first.expose_weights();
+        const size_t inputs = weights.get_rows_count();
+        const size_t outputs = weights.get_cols_count();
+        const std::vector<double>& shifts = input_normalizer.get_shifts();
+        const std::vector<double>& scales = input_normalizer.get_scales();
+
+        // fresh parameters, so a layer that views a mapped model file is never written to
+        lin_alg::Matrix folded_weights(inputs, outputs);
+        lin_alg::Vector folded_biases = first.expose_biases();
+        for (size_t i = 0; i < inputs; ++i) {
+            for (size_t j = 0; j < outputs; ++j) {
+                folded_weights(i, j) = weights(i, j) / scales[i];
+                folded_biases(j) -= shifts[i] * folded_weights(i, j);
             }
         }
 
-        return normalized;
+        layers.front() = NNLayer(std::move(folded_weights), std::move(folded_biases), first.get_activation());
+        input_normalizer = Normalizer(inputs);
     }
 
-    // Example if output was scaled between 0 and some max value
+    // Scales the outputs back from the range the network produces, [0, 1] for the default network, so no change
     lin_alg::Vector NeuralNetwork::denormalize_output(const lin_alg::Vector& output) const {
         lin_alg::Vector denormalized(output.get_size());
 
-        // Assuming the output should be denormalized to a different range (like 0 to 100 for example)
         for (size_t i = 0; i < output.get_size(); ++i) {
-            denormalized(i) = output(i) * 1.0;  // Since output is already in range [0, 1], no changes needed.
+            denormalized(i) = output(i) * output_scales[i];
         }
 
         return denormalized;
     }
 
-    lin_alg::Matrix NeuralNetwork::forward(const lin_alg::Matrix& input){
-        activations.clear();
-        outputs.clear();
+    void NeuralNetwork::denormalize_outputs_in_place(lin_alg::Matrix& outputs) const {
+        // Same scaling as denormalize_output
+        const size_t cols = outputs.get_cols_count();
+        double* values = outputs.get_data();
+        for (size_t r = 0; r < outputs.get_rows_count(); ++r) {
+            for (size_t c = 0; c < cols; ++c) {
+                values[r * cols + c] *= output_scales[c];
+            }
+        }
+    }
 
-        outputs.push_back(input);
+    void NeuralNetwork::forward_layer(size_t i, const lin_alg::Matrix& input, lin_alg::Matrix& out, lin_alg::Matrix* pre_activation) const{
+        const NNLayer& layer = layers[i];
+        lin_alg::gemm(input, layer.expose_weights(), out);
+        lin_alg::add_row_vector(out, layer.expose_biases());
 
+        const size_t count = out.get_rows_count() * out.get_cols_count();
+        if (pre_activation) std::copy_n(out.get_data(), count, pre_activation->get_data());
+
+        std::span<double> values(out.get_data(), count);
+        std::visit([&](const auto& kernel) { apply_kernel(kernel, values, values, out.get_cols_count()); }, layer.get_kernel());
+    }
+
+    bool NeuralNetwork::keeps_output(size_t i) const{
+        return i % checkpoint_every == 0 || i == layers.size();
+    }
+
+    bool NeuralNetwork::keeps_pre_activation(size_t i) const{
+        return layers[i].get_activation()->uses_pre_activation() || (i + 1 == layers.size() && loss->fused_activation());
+    }
+
+    const lin_alg::Matrix& NeuralNetwork::forward(const lin_alg::Matrix& input, ForwardContext& ctx) const{
+        diagnostics::TraceSpan span("train", "forward");
+        diagnostics::ScopedPhase allocations(ctx.timings.forward_pass());
+        const size_t rows = input.get_rows_count();
+        ctx.outputs.resize(layers.size() + 1);
+        ctx.pre_activations.resize(layers.size());
+        ctx.output_buffers.resize(layers.size() + 1);
+        ctx.pre_activation_buffers.resize(layers.size());
+
+        ctx.outputs[0] = workspace(ctx.output_buffers[0], rows, input.get_cols_count());
+        std::copy_n(input.get_data(), rows * input.get_cols_count(), ctx.outputs[0]->get_data());
+        const lin_alg::Matrix* previous = &*ctx.outputs[0];
+
+        // outputs that are not checkpointed only live until the next layer has consumed them, so two scratch buffers
+        // take turns: the one a layer writes is never the one it reads
+        std::array<std::optional<lin_alg::Matrix>, 2> scratch;
 
         for (size_t i = 0; i < layers.size(); i++){
-            const NNLayer& layer = layers[i];
-            lin_alg::Matrix act = (outputs[i] * layer.get_weights()).elementwise_add(layer.get_biases());
+            const size_t cols = layers[i].expose_biases().get_size();
 
-            std::function<double(double)> func = [&](double x) {return layer.get_activation()->apply(x);};
-            lin_alg::Matrix out = act.apply_to_elements(func);  
-            outputs.push_back(out);
+            lin_alg::Matrix* pre_activation = nullptr;
+            if (keeps_pre_activation(i)){
+                ctx.pre_activations[i] = workspace(ctx.pre_activation_buffers[i], rows, cols);
+                pre_activation = &*ctx.pre_activations[i];
+            }
+            else{
+                ctx.pre_activations[i].reset();
+            }
+
+            const bool kept = keeps_output(i + 1);
+            if (!kept) ctx.outputs[i + 1].reset();
+            std::optional<lin_alg::Matrix>& slot = kept ? ctx.outputs[i + 1] : scratch[i % 2];
+            slot = workspace(kept ? ctx.output_buffers[i + 1] : ctx.scratch_buffers[i % 2], rows, cols);
+            {
+                diagnostics::ScopedPhase timer(ctx.timings.forward(i));
+                diagnostics::TraceSpan layer_span("layer", "layer_forward", i);
+                forward_layer(i, *previous, *slot, pre_activation);
+            }
+            ctx.stats.layer_forwards++;
+            previous = &*slot;
+        }
 
+        ctx.stats.stored_bytes = 0;
+        for (const std::optional<lin_alg::Matrix>& output : ctx.outputs){
+            if (output) ctx.stats.stored_bytes += matrix_bytes(*output);
+        }
+        for (const std::optional<lin_alg::Matrix>& pre_activation : ctx.pre_activations){
+            if (pre_activation) ctx.stats.stored_bytes += matrix_bytes(*pre_activation);
         }
+        ctx.stats.peak_bytes = std::max(ctx.stats.peak_bytes, ctx.stats.stored_bytes);
 
-        return outputs.back();
+        return *ctx.outputs.back();
     }
 
     lin_alg::Vector NeuralNetwork::predict(const lin_alg::Vector& input) const{
@@ -100,191 +260,585 @@ namespace neural_network {
         return result;
     }
 
-    double NeuralNetwork::calc_rmse(const std::vector<lin_alg::Vector>& predicted_vals, 
-        const std::vector<lin_alg::Vector>& target_vals) const {
-        // Ensure both vectors have the same number of elements
-        if (predicted_vals.size() != target_vals.size()) {
-            throw std::invalid_argument("Predictions and targets must have the same number of elements");
+    size_t NeuralNetwork::get_input_size() const{
+        return layers.front().expose_weights().get_rows_count();
+    }
+
+    size_t NeuralNetwork::get_output_size() const{
+        return layers.back().expose_biases().get_size();
+    }
+
+    lin_alg::Matrix NeuralNetwork::predict_batch(const lin_alg::Matrix& inputs) const{
+        return predict_rows(inputs, true);
+    }
+
+    lin_alg::Matrix NeuralNetwork::predict_rows(const lin_alg::Matrix& inputs, bool normalize_inputs) const{
+        diagnostics::TraceSpan span("inference", "predict_batch");
+        const size_t input_cols = layers.front().expose_weights().get_rows_count();
+        if (inputs.get_cols_count() != input_cols){
+            throw std::invalid_argument(std::format("Expected {} input columns, got {}", input_cols, inputs.get_cols_count()));
         }
 
-        double square_err_sum = 0.0;
-        size_t num_elements = 0;
+        const size_t rows = inputs.get_rows_count();
+        lin_alg::Matrix predictions(rows, layers.back().expose_biases().get_size());
+
+        // buffers[0] holds the normalized input block, buffers[i + 1] the output of layer i.
+        // They are reused for every block, only the shorter tail block allocates again
+        std::vector<lin_alg::Matrix> buffers;
 
-        // Iterate through predictions
-        for (size_t i = 0; i < predicted_vals.size(); ++i) {
-            const lin_alg::Vector& predicted = predicted_vals[i];
-            const lin_alg::Vector& target = target_vals[i];
+        for (size_t offset = 0; offset < rows; offset += predict_block_rows){
+            const size_t block_rows = std::min(predict_block_rows, rows - offset);
 
-            // Ensure each vector has the same size
-            if (predicted.get_size() != target.get_size()) {
-                throw std::invalid_argument("Prediction and target vectors must have the same size");
+            if (buffers.empty() || buffers.front().get_rows_count() != block_rows){
+                buffers.clear();
+                buffers.push_back(lin_alg::Matrix(block_rows, input_cols));
+                for (const NNLayer& layer : layers){
+                    buffers.push_back(lin_alg::Matrix(block_rows, layer.expose_biases().get_size()));
+                }
             }
 
-            // Compute squared error
-            for (size_t j = 0; j < predicted.get_size(); ++j) {
-                double error = predicted(j) - target(j);
-                square_err_sum += error * error;
+            std::copy_n(inputs.get_data() + offset * input_cols, block_rows * input_cols, buffers.front().get_data());
+            if (normalize_inputs) input_normalizer.apply(buffers.front());
+
+            for (size_t i = 0; i < layers.size(); i++){
+                const NNLayer& layer = layers[i];
+                lin_alg::Matrix& out = buffers[i + 1];
+                lin_alg::gemm(buffers[i], layer.expose_weights(), out);
+
+                const double* bias = layer.expose_biases().get_data();
+                const size_t cols = out.get_cols_count();
+                double* values = out.get_data();
+
+                for (size_t r = 0; r < block_rows; r++){
+                    for (size_t c = 0; c < cols; c++){
+                        values[r * cols + c] += bias[c];
+                    }
+                }
+                // the activation is resolved once per block, the element loop is inlined
+                std::span<double> block(values, block_rows * cols);
+                std::visit([&](const auto& kernel) { apply_kernel(kernel, block, block, cols); }, layer.get_kernel());
             }
 
-            num_elements += predicted.get_size();  
+            const lin_alg::Matrix& block_out = buffers.back();
+            std::copy_n(block_out.get_data(), block_out.get_rows_count() * block_out.get_cols_count(),
+                predictions.get_data() + offset * predictions.get_cols_count());
         }
 
-        // Prevent division by zero
-        if (num_elements == 0) {
-            throw std::runtime_error("RMSE calculation: No elements to process (empty input).");
-        }
+        denormalize_outputs_in_place(predictions);
+        return predictions;
+    }
 
-        return std::sqrt(square_err_sum / num_elements);  // Compute and return RMSE
+    void NeuralNetwork::train(Dataset& training_data, int epochs, double learning_rate, size_t threads) {
+        TrainingOptions options;
+        options.epochs = epochs;
+        options.schedule = std::make_shared<ConstantSchedule>(learning_rate);
+        options.threads = threads;
+        train(training_data, options);
     }
 
+    void NeuralNetwork::train(std::vector<TrainingSample>& training_data, int epochs, double learning_rate, size_t threads) {
+        Dataset dataset = Dataset::from_samples(training_data);
+        normalize(dataset);
+        train(dataset, epochs, learning_rate, threads);
+    }
+
+    TrainingResult NeuralNetwork::train(std::vector<TrainingSample>& training_data, const TrainingOptions& options) {
+        Dataset dataset = Dataset::from_samples(training_data);
+        normalize(dataset);
+        return train(dataset, options);
+    }
+
+    TrainingResult NeuralNetwork::train(Dataset& training_data, const TrainingOptions& options) {
+        // PRINTN("weights before")
+        // layers.front().get_weights().print_matrix();
+        const size_t threads = options.threads;
+        if (threads == 0) throw std::invalid_argument("Thread count must be >= 1");
+        if (!options.schedule) throw std::invalid_argument("Training needs a learning rate schedule");
+        if (options.eval_every < 1) throw std::invalid_argument("eval_every must be >= 1");
+
+        check_dataset(training_data);
+        EpochSampler sampler(training_data, batch_size, options.sampling, options.strata);
+
+        // every batch is split into shard_count shards; the split and the reduction order only depend on the shard count,
+        // the threads merely decide how many shards run at once
+        const size_t shard_count = options.gradient_shards > 0 ? options.gradient_shards : threads;
+        std::vector<ForwardContext> replicas(shard_count);
+        std::unique_ptr<parallel::ThreadPool> pool;
+        if (shard_count > 1){
+            pool = std::make_unique<parallel::ThreadPool>(threads);
+        }
+
+        TrainingResult result;
+        std::vector<NNLayer> best_layers = layers;
+        TrainingProgress progress;
+        if (!options.resume_from.empty()){
+            progress = restore_checkpoint(options.resume_from, best_layers, *options.schedule);
+            result.epochs_run = progress.next_epoch;
+            result.best_epoch = progress.best_epoch;
+            result.best_validation_rmse = progress.best_validation_rmse;
+        }
+
+        std::unique_ptr<CheckpointWriter> checkpoint_writer;
+        std::vector<char> snapshot;
+        if (options.checkpoint_every > 0){
+            if (options.checkpoint_path.empty()) throw std::invalid_argument("Checkpoints need a checkpoint_path");
+            checkpoint_writer = std::make_unique<CheckpointWriter>(options.checkpoint_path);
+        }
+        const bool keeps_best = options.validation_data != nullptr;
+
+        std::unique_ptr<diagnostics::TrainingTelemetry> telemetry;
+        if constexpr (diagnostics::telemetry_compiled){
+            if (options.record_telemetry || !options.telemetry_path.empty()){
+                telemetry = std::make_unique<diagnostics::TrainingTelemetry>(layers.size());
+                context.timings.enable(layers.size());
+                for (ForwardContext& replica : replicas) replica.timings.enable(layers.size());
+            }
+        }
+
+        for (int epoch = progress.next_epoch; epoch < options.epochs; ++epoch) {
+            diagnostics::TraceSpan epoch_span("train", "epoch", epoch + 1);
+            double learning_rate = options.schedule->rate(epoch);
+            result.epochs_run = epoch + 1;
+            if (telemetry) telemetry->begin_epoch(epoch + 1, learning_rate);
+
+            RandomStream order(seed, RandomStreamKind::EpochOrder, static_cast<uint32_t>(epoch));
+            sampler.start_epoch(order);
+            if (pool){
+                for (size_t b = 0; b < sampler.get_batch_count(); ++b){
+                    // the shards view the gathered batch - their boundaries only depend on the shard count
+                    std::optional<TrainingBatch> batch;
+                    {
+                        diagnostics::ScopedPhase timer(phase_slot(telemetry.get(), diagnostics::Phase::BatchAssembly));
+                        batch = sampler.gather(b);
+                    }
+                    train_step_parallel(split_batch(*batch, shard_count), replicas, *pool, learning_rate, telemetry.get());
+                }
+            }
+            else{
+                train_epoch(sampler, learning_rate, telemetry.get());
+            }
+
+            if (telemetry){
+                telemetry->collect(context.timings);
+                for (ForwardContext& replica : replicas) telemetry->collect(replica.timings);
+            }
+
+            bool stop = false;
+            if (keeps_best && (epoch + 1) % options.eval_every == 0){
+                diagnostics::ScopedPhase timer(phase_slot(telemetry.get(), diagnostics::Phase::Validation));
+                diagnostics::TraceSpan span("train", "validation");
+                double rmse = validation_rmse(*options.validation_data);
+                options.schedule->observe(rmse);
+
+                if (rmse < result.best_validation_rmse - options.min_delta){
+                    result.best_validation_rmse = rmse;
+                    result.best_epoch = epoch + 1;
+                    best_layers = layers;
+                    progress.evaluations_without_improvement = 0;
+                }
+                else if (options.patience > 0 && ++progress.evaluations_without_improvement >= options.patience){
+                    result.stopped_early = true;
+                    stop = true;
+                }
+            }
+
+            if (!stop && checkpoint_writer && (epoch + 1) % options.checkpoint_every == 0){
+                diagnostics::ScopedPhase timer(phase_slot(telemetry.get(), diagnostics::Phase::Checkpoint));
+                diagnostics::TraceSpan span("train", "checkpoint");
+                auto start = std::chrono::steady_clock::now();
+
+                progress.next_epoch = epoch + 1;
+                progress.best_epoch = result.best_epoch;
+                progress.best_validation_rmse = result.best_validation_rmse;
+                serialize_checkpoint(snapshot, progress, keeps_best ? &best_layers : nullptr, *options.schedule);
+                checkpoint_writer->submit(snapshot);
 
-    double NeuralNetwork::calc_correlation(const std::vector<lin_alg::Vector>& predicted_vals,
-         const std::vector<lin_alg::Vector>& target_vals) const {
-        // Ensure both vectors have the same number of elements
-        if (predicted_vals.size() != target_vals.size()) {
-        throw std::invalid_argument("Predictions and targets must have the same number of elements");
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                result.checkpoints.snapshot_seconds += elapsed.count();
+            }
+
+            if (telemetry) telemetry->end_epoch();
+            if (stop) break;
+        }
+
+        if (telemetry){
+            context.timings = {};
+            result.telemetry = telemetry->get_epochs();
+            if (!options.telemetry_path.empty()) telemetry->write(options.telemetry_path);
+        }
+
+        if (checkpoint_writer){
+            double snapshot_seconds = result.checkpoints.snapshot_seconds;
+            result.checkpoints = checkpoint_writer->finish();
+            result.checkpoints.snapshot_seconds = snapshot_seconds;
         }
 
-        size_t num_elements = 0;
-        double sum_predicted = 0.0;
-        double sum_target = 0.0;
-        double sum_predicted_squared = 0.0;
-        double sum_target_squared = 0.0;
-        double sum_product = 0.0;
+        if (keeps_best && options.restore_best && result.best_epoch > 0){
+            layers = best_layers;
+        }
+    // PRINTN("weights after")
+    // layers.front().get_weights().print_matrix();
+        return result;
+    }
+
+    double NeuralNetwork::batch_loss(const ForwardContext& ctx) const{
+        const lin_alg::Matrix& out = *ctx.outputs.back();
+        return ctx.loss / loss->term_count(out.get_rows_count(), out.get_cols_count());
+    }
+
+    void NeuralNetwork::record_batch_loss(diagnostics::TrainingTelemetry& telemetry, const ForwardContext& ctx) const{
+        const lin_alg::Matrix& out = *ctx.outputs.back();
+        telemetry.add_batch(out.get_rows_count(), ctx.loss, loss->term_count(out.get_rows_count(), out.get_cols_count()));
+    }
 
-        // First pass: Compute sums
-        for (size_t i = 0; i < predicted_vals.size(); ++i) {
-        const lin_alg::Vector& predicted = predicted_vals[i];
-        const lin_alg::Vector& target = target_vals[i];
+    LearningRateSweep NeuralNetwork::find_learning_rate(std::vector<TrainingSample>& training_data, double min_rate, double max_rate,
+        size_t steps, const std::string& csv_path){
+        if (min_rate <= 0 || max_rate <= min_rate) throw std::invalid_argument("Learning rate range must satisfy 0 < min_rate < max_rate");
+        if (steps < 2) throw std::invalid_argument("Learning rate sweep needs at least 2 steps");
+
+        std::vector<NNLayer> snapshot = layers;
+        Dataset dataset = Dataset::from_samples(training_data);
+        normalize(dataset);
+        std::vector<TrainingBatch> batches = create_batches(dataset);
+        optimizer->reset();
+
+        LearningRateSweep sweep;
+        const double growth = std::pow(max_rate / min_rate, 1.0 / (steps - 1));
+        const double smoothing = 0.98;
+        double average = 0;
+        double best = std::numeric_limits<double>::infinity();
+
+        for (size_t step = 0; step < steps; step++){
+            double learning_rate = min_rate * std::pow(growth, static_cast<double>(step));
+            const TrainingBatch& batch = batches[step % batches.size()];
+
+            forward(batch.inputs, context);
+            const std::vector<LayerGradients>& gradients = compute_gradients(batch, context);
+            double loss = batch_loss(context);
+            apply_gradients(gradients, learning_rate);
+
+            // exponential moving average with bias correction, so the first steps are not pulled towards 0
+            average = smoothing * average + (1 - smoothing) * loss;
+            double smoothed = average / (1 - std::pow(smoothing, static_cast<double>(step + 1)));
+
+            sweep.learning_rates.push_back(learning_rate);
+            sweep.losses.push_back(loss);
+            sweep.smoothed_losses.push_back(smoothed);
+
+            best = std::min(best, smoothed);
+            if (!std::isfinite(smoothed) || smoothed > 4 * best) break;
+        }
 
-        if (predicted.get_size() != target.get_size()) {
-        throw std::invalid_argument("Prediction and target vectors must have the same size");
+        layers = snapshot;
+        optimizer->reset();
+
+        // the steepest descent of the smoothed loss over log(learning rate), ignoring the first steps
+        // while the moving average is still settling and the diverging tail
+        const size_t warmup = std::min<size_t>(10, sweep.smoothed_losses.size() / 10);
+        double steepest = 0;
+        sweep.suggested_rate = sweep.learning_rates.front();
+        for (size_t i = warmup + 1; i < sweep.smoothed_losses.size(); i++){
+            if (!std::isfinite(sweep.smoothed_losses[i]) || sweep.smoothed_losses[i] > 4 * best) break;
+
+            double slope = (sweep.smoothed_losses[i] - sweep.smoothed_losses[i - 1]) / std::log(growth);
+            if (slope < steepest){
+                steepest = slope;
+                sweep.suggested_rate = sweep.learning_rates[i];
+            }
         }
 
-        for (size_t j = 0; j < predicted.get_size(); ++j) {
-        double pred = predicted(j);
-        double targ = target(j);
+        if (!csv_path.empty()){
+            std::ofstream csv(csv_path);
+            if (!csv.is_open()) throw std::runtime_error("Could not open file: " + csv_path);
 
-        sum_predicted += pred;
-        sum_target += targ;
-        sum_predicted_squared += pred * pred;
-        sum_target_squared += targ * targ;
-        sum_product += pred * targ;
+            csv << "learning_rate,loss,smoothed_loss\n";
+            for (size_t i = 0; i < sweep.learning_rates.size(); i++){
+                csv << sweep.learning_rates[i] << "," << sweep.losses[i] << "," << sweep.smoothed_losses[i] << "\n";
+            }
         }
 
-        num_elements += predicted.get_size();
+        return sweep;
+    }
+
+    void NeuralNetwork::train_epoch(EpochSampler& sampler, double learning_rate, diagnostics::TrainingTelemetry* telemetry){
+        for (size_t b = 0; b < sampler.get_batch_count(); ++b) {
+            std::optional<TrainingBatch> batch;
+            {
+                diagnostics::ScopedPhase timer(phase_slot(telemetry, diagnostics::Phase::BatchAssembly));
+                batch = sampler.gather(b);
+            }
+            forward(batch->inputs, context);
+            const std::vector<LayerGradients>& gradients = compute_gradients(*batch, context);
+            if (telemetry) record_batch_loss(*telemetry, context);
+
+            diagnostics::ScopedPhase timer(phase_slot(telemetry, diagnostics::Phase::Update));
+            apply_gradients(gradients, learning_rate);
         }
+    }
+
+    PipelineStats NeuralNetwork::train_pipelined(const std::vector<TrainingSample>& training_data, int epochs, double learning_rate, size_t depth){
+        BatchPipeline pipeline(training_data, batch_size, epochs, seed, [this](lin_alg::Matrix& inputs) {
+            input_normalizer.apply(inputs);
+        }, depth);
+
+        double compute_seconds = 0;
+        for (const TrainingBatch* batch = pipeline.acquire(); batch != nullptr; batch = pipeline.acquire()){
+            auto start = std::chrono::steady_clock::now();
+            forward(batch->inputs, context);
+            backward(*batch, learning_rate);
+            compute_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        if (num_elements == 0) {
-        throw std::runtime_error("Correlation calculation: No elements to process (empty input).");
+            pipeline.release();
         }
 
-        // Compute means
-        double mean_predicted = sum_predicted / num_elements;
-        double mean_target = sum_target / num_elements;
+        PipelineStats stats = pipeline.get_stats();
+        stats.compute_seconds = compute_seconds;
+        return stats;
+    }
+
+    void NeuralNetwork::train_step_parallel(const std::vector<TrainingBatch>& shards, std::vector<ForwardContext>& replicas,
+        parallel::ThreadPool& pool, double learning_rate, diagnostics::TrainingTelemetry* telemetry){
+        std::vector<std::vector<LayerGradients>> shard_gradients(shards.size());
 
-        // Compute covariance and variances
-        double covariance = (sum_product / num_elements) - (mean_predicted * mean_target);
-        double variance_predicted = (sum_predicted_squared / num_elements) - (mean_predicted * mean_predicted);
-        double variance_target = (sum_target_squared / num_elements) - (mean_target * mean_target);
+        pool.run(shards.size(), [&](size_t s) {
+            diagnostics::TraceSpan span("train", "shard", s);
+            forward(shards[s].inputs, replicas[s]);
+            shard_gradients[s] = compute_gradients(shards[s], replicas[s]);
+        });
 
-        // Check for zero variance
-        if (variance_predicted == 0 || variance_target == 0) {
-        return 0.0;  // No correlation if either variance is zero
+        if (telemetry){
+            for (size_t s = 0; s < shards.size(); s++) record_batch_loss(*telemetry, replicas[s]);
         }
 
-        // Pearson correlation coefficient
-        double correlation = covariance / (std::sqrt(variance_predicted) * std::sqrt(variance_target));
+        {
+            diagnostics::ScopedPhase timer(phase_slot(telemetry, diagnostics::Phase::GradientReduction));
+            diagnostics::TraceSpan span("train", "reduce_gradients");
+            reduce_gradients(shard_gradients, pool);
+        }
+        diagnostics::ScopedPhase timer(phase_slot(telemetry, diagnostics::Phase::Update));
+        apply_gradients(shard_gradients.front(), learning_rate);
+    }
 
-        return correlation;
-        }    
+    void NeuralNetwork::reduce_gradients(std::vector<std::vector<LayerGradients>>& shard_gradients, parallel::ThreadPool& pool) const{
+        const size_t shard_count = shard_gradients.size();
 
-    void NeuralNetwork::train(std::vector<TrainingSample>& training_data, int epochs, double learning_rate) {
-        // PRINTN("weights before")
-        // layers.front().get_weights().print_matrix();
-        std::vector<TrainingBatch> batches = create_batches(training_data);
-        for (int epoch = 0; epoch < epochs; ++epoch) {
-            std::random_device rd;  // Get a random seed from the OS
-            std::mt19937 g(rd());   // Use Mersenne Twister PRNG
-
-            // Shuffle the data
-            std::shuffle(training_data.begin(), training_data.end(), g);
-            for (const TrainingBatch& batch : batches) {
-
-                lin_alg::Matrix normalized_inputs(batch.inputs.get_rows_count(), batch.inputs.get_cols_count());
-                
-                //normalize inputs
-                for (size_t i = 0; i < batch.inputs.get_rows_count(); ++i) {
-                    lin_alg::Vector input_row = lin_alg::Vector::from_matrix_row(batch.inputs, i);
-                    lin_alg::Vector normalized_input = normalize_input(input_row);
-                    for (size_t j = 0; j < normalized_input.get_size(); ++j) {
-                        normalized_inputs(i, j) = normalized_input(j);
-                    }
+        // pairwise tree: on every level shard i absorbs shard i + stride, so the summation order never changes
+        for (size_t stride = 1; stride < shard_count; stride *= 2){
+            size_t pair_count = (shard_count - stride + 2 * stride - 1) / (2 * stride);
+
+            pool.run(pair_count, [&](size_t p) {
+                size_t target = p * 2 * stride;
+                std::vector<LayerGradients>& into = shard_gradients[target];
+                const std::vector<LayerGradients>& from = shard_gradients[target + stride];
+
+                for (size_t l = 0; l < into.size(); l++){
+                    into[l].weights += from[l].weights;
+                    into[l].biases += from[l].biases;
                 }
-                lin_alg::Matrix out = forward(batch.inputs);
-                backward(batch, learning_rate);
+            });
         }
     }
-    // PRINTN("weights after")
-    // layers.front().get_weights().print_matrix();
-}
 
-    void NeuralNetwork::test(const std::vector<TrainingSample>& test_data) const{
-        std::vector<lin_alg::Vector> predicted_results;
-        
-        std::vector<lin_alg::Vector> expected_results;
-        for (const TrainingSample& sample : test_data){
+    double NeuralNetwork::validation_rmse(const Dataset& validation_data) const{
+        if (validation_data.get_row_count() == 0) throw std::runtime_error("RMSE calculation: No elements to process (empty input).");
+
+        return evaluate_rows(validation_data, false, 1).rmse;
+    }
+
+    RegressionMetrics NeuralNetwork::evaluate(const Dataset& data, size_t threads) const{
+        return evaluate_rows(data, true, threads);
+    }
+
+    RegressionMetrics NeuralNetwork::evaluate_rows(const Dataset& data, bool normalize_inputs, size_t threads) const{
+        if (threads == 0) throw std::invalid_argument("Thread count must be >= 1");
+        check_dataset(data);
+
+        const size_t rows = data.get_row_count();
+        const size_t chunk_count = (rows + evaluate_chunk_rows - 1) / evaluate_chunk_rows;
+        std::vector<MetricAccumulator> chunks(chunk_count);
+
+        auto score_chunk = [&](size_t c) {
+            diagnostics::TraceSpan span("inference", "evaluate_chunk", c);
+            const size_t offset = c * evaluate_chunk_rows;
+            const size_t chunk_rows = std::min(evaluate_chunk_rows, rows - offset);
+            // read-only views, the data set is never written through them
+            lin_alg::Matrix inputs = lin_alg::Matrix::view(const_cast<double*>(data.get_features().get_data()) + offset * data.get_input_count(),
+                chunk_rows, data.get_input_count());
+            lin_alg::Matrix targets = lin_alg::Matrix::view(const_cast<double*>(data.get_targets().get_data()) + offset * data.get_output_count(),
+                chunk_rows, data.get_output_count());
+            chunks[c].add(predict_rows(inputs, normalize_inputs), targets);
+        };
+
+        if (threads > 1 && chunk_count > 1){
+            parallel::ThreadPool pool(std::min(threads, chunk_count));
+            pool.run(chunk_count, score_chunk);
+        }
+        else{
+            for (size_t c = 0; c < chunk_count; c++) score_chunk(c);
+        }
 
-            lin_alg::Vector in = normalize_input(lin_alg::Vector::from_std_vector(sample.input_data));
-            lin_alg::Vector expected = lin_alg::Vector::from_std_vector(sample.expected_output);
-            predicted_results.push_back(denormalize_output(predict(in)));
-            expected_results.push_back(expected);
+        // pairwise tree: on every level chunk i absorbs chunk i + stride
+        for (size_t stride = 1; stride < chunk_count; stride *= 2){
+            for (size_t target = 0; target + stride < chunk_count; target += 2 * stride){
+                chunks[target].merge(chunks[target + stride]);
+            }
         }
+        return chunks.front().get_metrics();
+    }
+
+    void NeuralNetwork::test(const std::vector<TrainingSample>& test_data) const{
+        if (test_data.empty()) throw std::runtime_error("Test calculation: No elements to process (empty input).");
+
+        test(Dataset::from_samples(test_data));
+    }
+
+    void NeuralNetwork::test(const Dataset& test_data) const{
+        if (test_data.get_row_count() == 0) throw std::runtime_error("Test calculation: No elements to process (empty input).");
+
+        RegressionMetrics metrics = evaluate(test_data, std::max(1u, std::thread::hardware_concurrency()));
 
         PRINTN("")
         PRINTN("Model accuracy:")
-        
-        double rmse = calc_rmse(predicted_results, expected_results);
-        PRINTN("RMSE: " << rmse)
-        
-        double corr = calc_correlation(predicted_results, expected_results);
-        PRINTN("Correlation: " << corr)
+        PRINTN("RMSE: " << metrics.rmse)
+        PRINTN("MAE: " << metrics.mae)
+        PRINTN("R^2: " << metrics.r_squared)
+        PRINTN("Correlation: " << metrics.pearson)
     }
 
-    void NeuralNetwork::backward(const TrainingBatch& batch, double learning_rate){
-        std::vector<lin_alg::Matrix> deltas;
-        lin_alg::Matrix init_err = batch.expected_outputs - outputs.back();
-        std::function<double(double)> func = [&](double x) {return layers.back().get_activation()->applyDerivative(x);};
-        lin_alg::Matrix init_delta = init_err.elementwise_mult(outputs.back().apply_to_elements(func));
+    const std::vector<LayerGradients>& NeuralNetwork::compute_gradients(const TrainingBatch& batch, ForwardContext& ctx) const{
+        diagnostics::TraceSpan span("train", "backward");
+        diagnostics::ScopedPhase allocations(ctx.timings.backward_pass());
+        const size_t layer_count = layers.size();
+
+        // outputs dropped by checkpointing are recomputed from the closest checkpoint below them,
+        // one segment at a time - the backward pass walks down the layers, so every segment is rebuilt once
+        std::vector<lin_alg::Matrix> segment;
+        size_t segment_start = 0;
+
+        auto output = [&](size_t i) -> const lin_alg::Matrix& {
+            if (ctx.outputs[i]) return *ctx.outputs[i];
+
+            if (segment.empty() || i < segment_start){
+                size_t checkpoint = i - 1;
+                while (!ctx.outputs[checkpoint]) checkpoint--;
+
+                segment.clear();
+                segment_start = checkpoint + 1;
+
+                size_t segment_bytes = 0;
+                for (size_t j = segment_start; j <= i; j++){
+                    const lin_alg::Matrix& in = j == segment_start ? *ctx.outputs[checkpoint] : segment.back();
+                    lin_alg::Matrix out(in.get_rows_count(), layers[j - 1].expose_biases().get_size());
+                    forward_layer(j - 1, in, out);
+                    segment_bytes += matrix_bytes(out);
+                    segment.push_back(std::move(out));
+                    ctx.stats.recomputed_layers++;
+                }
+                ctx.stats.peak_bytes = std::max(ctx.stats.peak_bytes, ctx.stats.stored_bytes + segment_bytes);
+            }
 
-        deltas.push_back(init_delta);
-        
-        for (size_t i = layers.size() - 1; i > 0; i--){
+            return segment[i - segment_start];
+        };
+
+        // values (.)= f'(x) of layer l, from the layer's output y and, for GELU, its stored pre-activation x.
+        // The activation is resolved once per call, the element loop is inlined
+        auto scale_by_layer_derivative = [&](size_t l, const lin_alg::Matrix& y, lin_alg::Matrix& values) {
+            const size_t count = y.get_rows_count() * y.get_cols_count();
+            const std::optional<lin_alg::Matrix>& x = ctx.pre_activations[l];
+            assertm(x || !layers[l].get_activation()->uses_pre_activation(), "The forward pass did not keep a needed pre-activation");
+
+            std::span<const double> pre_activation = x ? std::span<const double>(x->get_data(), count) : std::span<const double>();
+            std::visit([&](const auto& kernel) {
+                scale_by_derivative(kernel, pre_activation, std::span<const double>(y.get_data(), count), std::span<double>(values.get_data(), count),
+                    y.get_cols_count());
+            }, layers[l].get_kernel());
+        };
+
+        const lin_alg::Matrix& network_output = *ctx.outputs.back();
+        const size_t rows = network_output.get_rows_count();
+        const size_t output_count = rows * network_output.get_cols_count();
+        lin_alg::Matrix delta = workspace(ctx.delta_buffer, rows, network_output.get_cols_count());
+        {
+            diagnostics::ScopedPhase timer(ctx.timings.backward(layer_count - 1));
+            diagnostics::TraceSpan layer_span("layer", "output_delta", layer_count - 1);
+            // a fused loss starts from the logits and its gradient already includes the output activation's derivative
+            if (loss->fused_activation()){
+                assertm(ctx.pre_activations[layer_count - 1], "The forward pass did not keep the logits of the fused loss");
+                std::copy_n(ctx.pre_activations[layer_count - 1]->get_data(), output_count, delta.get_data());
+                ctx.loss = loss->gradient(delta, batch.expected_outputs);
+            }
+            else{
+                std::copy_n(network_output.get_data(), output_count, delta.get_data());
+                ctx.loss = loss->gradient(delta, batch.expected_outputs);
+                scale_by_layer_derivative(layer_count - 1, network_output, delta);
+            }
+        }
 
-            NNLayer& layer = layers[i];
-            lin_alg::Matrix prevDelta = deltas.back();
-            lin_alg::Matrix weightsT = layer.get_weights().transpose();
+        if (ctx.gradients.size() != layer_count){
+            ctx.gradients.clear();
+            for (const NNLayer& layer : layers){
+                const lin_alg::Matrix& weights = layer.expose_weights();
+                ctx.gradients.push_back(LayerGradients{lin_alg::Matrix(weights.get_rows_count(), weights.get_cols_count()),
+                    lin_alg::Vector(weights.get_cols_count())});
+            }
+        }
 
-            assertm(prevDelta.get_cols_count() == weightsT.get_rows_count(), "Delta cols and weightT rows are not equal");
+        // walk down from the last layer; delta and the error of the layer below take turns in two buffers
+        for (size_t i = layer_count; i-- > 0;){
+            diagnostics::ScopedPhase timer(ctx.timings.backward(i));
+            diagnostics::TraceSpan layer_span("layer", "layer_backward", i);
+            const lin_alg::Matrix& layer_input = output(i);
+            LayerGradients& gradients = ctx.gradients[i];
 
-            lin_alg::Matrix err = prevDelta * weightsT;
+            lin_alg::Matrix input_t = workspace(ctx.transpose_buffer, layer_input.get_cols_count(), rows);
+            lin_alg::transpose_into(layer_input, input_t);
+            lin_alg::gemm(input_t, delta, gradients.weights);
+            lin_alg::column_sums(delta, gradients.biases);
 
-            std::function<double(double)> func = [&](double x) {return layer.get_activation()->applyDerivative(x);};
-            lin_alg::Matrix delta = err.elementwise_mult(outputs[i].apply_to_elements(func));
+            if (i == 0) break;
 
-            deltas.push_back(delta);
-        }
+            const lin_alg::Matrix& weights = layers[i].expose_weights();
+            lin_alg::Matrix weights_t = workspace(ctx.transpose_buffer, weights.get_cols_count(), weights.get_rows_count());
+            lin_alg::transpose_into(weights, weights_t);
 
+            assertm(delta.get_cols_count() == weights_t.get_rows_count(), "Delta cols and weightT rows are not equal");
 
-        assertm(layers.size() == deltas.size(), "Deltas size must be equal to layers size!");
-        std::reverse(deltas.begin(), deltas.end());
+            // layer_input is the output of layer i - 1, so its derivative is the one of layer i - 1's activation
+            lin_alg::Matrix err = workspace(ctx.error_buffer, rows, weights_t.get_cols_count());
+            lin_alg::gemm(delta, weights_t, err);
+            scale_by_layer_derivative(i - 1, layer_input, err);
+            std::swap(ctx.delta_buffer, ctx.error_buffer);
+            delta = std::move(err);
+        }
+
+        return ctx.gradients;
+    }
 
+    void NeuralNetwork::apply_gradients(const std::vector<LayerGradients>& gradients, double learning_rate){
+        diagnostics::TraceSpan span("train", "update");
+        optimizer->begin_step();
         for (size_t i = 0; i < layers.size(); i++){
-            NNLayer& layer = layers[i];
-            lin_alg::Matrix delta = deltas[i];
-            lin_alg::Matrix weightDiff = (outputs[i].transpose() * delta) * learning_rate;
-            lin_alg::Vector biasDiff = delta.collapse_rows() * learning_rate;
-            layer.update(weightDiff, biasDiff);
+            diagnostics::TraceSpan layer_span("layer", "layer_update", i);
+            layers[i].update(*optimizer, i, gradients[i], learning_rate);
+        }
+    }
+
+    void NeuralNetwork::backward(const TrainingBatch& batch, double learning_rate){
+        apply_gradients(compute_gradients(batch, context), learning_rate);
+    }
+
+    double NeuralNetwork::train_batch(const TrainingBatch& batch, double learning_rate){
+        if (batch.inputs.get_cols_count() != get_input_size() || batch.expected_outputs.get_cols_count() != get_output_size()
+            || batch.inputs.get_rows_count() != batch.expected_outputs.get_rows_count()){
+            throw std::invalid_argument(std::format("A batch of {}x{} inputs and {}x{} targets does not fit a network with {} inputs and {} outputs",
+                batch.inputs.get_rows_count(), batch.inputs.get_cols_count(), batch.expected_outputs.get_rows_count(),
+                batch.expected_outputs.get_cols_count(), get_input_size(), get_output_size()));
         }
+
+        forward(batch.inputs, context);
+        const std::vector<LayerGradients>& gradients = compute_gradients(batch, context);
+        const double mean_loss = batch_loss(context);
+        apply_gradients(gradients, learning_rate);
+        return mean_loss;
     }
 }
@@ -1,24 +1,212 @@
 #pragma once
 
 #include <vector>
+#include <limits>
+#include <string>
+#include <optional>
+#include <array>
+#include <memory>
 #include "../linear_algebra/lin_alg.h"
 #include "activation_funcs.h"
+#include "dataset.h"
+#include "sampler.h"
+#include "normalizer.h"
+#include "metrics.h"
+#include "optimizer.h"
+#include "loss.h"
+#include "random.h"
+#include "schedules.h"
+#include "../parallel/thread_pool.h"
+#include "../diagnostics/telemetry.h"
+
+namespace file_handling{
+    class MappedFile;
+}
 
 namespace neural_network{
 
     #define PRINTN(x)std::cout << x << std::endl;
     #define PRINT_DEBUG(x)std::cout << x << std::endl;
 
-    /// @brief Represents a single training sample for an iteration:
-    /// the inputs for each input neuron and the expected output for each output neuron
-    struct TrainingSample{
-        std::vector<double> input_data;
-        std::vector<double> expected_output;
+    /// @brief The pre-activation values and the activated outputs of a layer for a whole batch
+    struct ForwardResult{
+        lin_alg::Matrix z;
+        lin_alg::Matrix output;
+    };
+
+    /// @brief Activation memory of the forward/backward passes against the extra compute spent on recomputation
+    struct ActivationMemoryStats{
+        size_t stored_bytes = 0;        // outputs kept after the last forward pass
+        size_t peak_bytes = 0;          // kept plus recomputed outputs at the worst point of a backward pass
+        size_t layer_forwards = 0;      // layer evaluations done by forward passes
+        size_t recomputed_layers = 0;   // layer evaluations repeated by backward passes
+    };
+
+    /// @brief The loss gradients of a single layer's weights and biases, summed over the rows of a batch
+    struct LayerGradients{
+        lin_alg::Matrix weights;
+        lin_alg::Vector biases;
+    };
+
+    /// @brief The outputs of every layer from a single forward pass, kept for the backward pass.
+    /// outputs[0] is the input batch and outputs[i + 1] the output of layer i. With activation checkpointing
+    /// only every k-th entry and the final output are kept, the others are empty and get recomputed.
+    /// Every training thread owns its own context, so the replicas never share scratch state
+    struct ForwardContext{
+        std::vector<std::optional<lin_alg::Matrix>> outputs;
+        // pre-activations of the layers whose activation derivative needs them (GELU) and the logits of the last layer
+        // when the loss is fused with its activation, kept whatever the checkpointing
+        std::vector<std::optional<lin_alg::Matrix>> pre_activations;
+        // summed loss of the batch, set by the backward pass
+        double loss = 0;
+        ActivationMemoryStats stats;
+        diagnostics::LayerTimings timings;
+
+        // the storage behind outputs and pre_activations and the buffers of the backward pass. They are kept from batch
+        // to batch and grow to the largest batch seen, smaller batches view their first rows, so a training step
+        // without activation checkpointing allocates nothing once the first batch has gone through
+        std::vector<std::optional<lin_alg::Matrix>> output_buffers;
+        std::vector<std::optional<lin_alg::Matrix>> pre_activation_buffers;
+        std::array<std::optional<lin_alg::Matrix>, 2> scratch_buffers;     // outputs that are not checkpointed
+        std::optional<lin_alg::Matrix> delta_buffer;
+        std::optional<lin_alg::Matrix> error_buffer;
+        std::optional<lin_alg::Matrix> transpose_buffer;
+        std::vector<LayerGradients> gradients;
+    };
+
+    /// @brief Throughput and staleness figures of an asynchronous training run.
+    /// Staleness is the number of updates other workers applied between reading the weights and writing a gradient
+    struct AsyncTrainingStats{
+        size_t updates = 0;
+        size_t samples = 0;
+        double seconds = 0;
+        double samples_per_second = 0;
+        double mean_staleness = 0;
+        size_t max_staleness = 0;
+    };
+
+    /// @brief Settings of a training run
+    struct TrainingOptions{
+        int epochs = 1;
+        std::shared_ptr<LearningRateSchedule> schedule;
+        size_t threads = 1;
+
+        /// @brief Number of row ranges every batch is split into for the gradient computation, 0 takes one per thread.
+        /// The shard gradients are summed in a fixed tree, so with a fixed shard count the weights no longer depend
+        /// on the thread count - the same seed trains the same network on 1 or 64 threads
+        size_t gradient_shards = 0;
+
+        /// @brief The row order of every epoch, see EpochSampler. strata only applies to SamplingMode::Stratified
+        SamplingMode sampling = SamplingMode::Shuffle;
+        size_t strata = 10;
+
+        /// @brief Held-out samples the RMSE is measured on every eval_every epochs, nullptr disables validation.
+        /// Normalized like the training data (see NeuralNetwork::normalize)
+        const Dataset* validation_data = nullptr;
+        int eval_every = 1;
+
+        /// @brief Stop after this many evaluations in a row that did not improve the best RMSE by more than min_delta, 0 never stops early
+        int patience = 0;
+        double min_delta = 0;
+
+        /// @brief Put back the weights of the best evaluation once training ends
+        bool restore_best = true;
+
+        /// @brief Write a checkpoint to checkpoint_path after every checkpoint_every epochs, 0 disables checkpoints.
+        /// Checkpoints are written in the background and replace the previous one atomically
+        std::string checkpoint_path;
+        int checkpoint_every = 0;
+
+        /// @brief Continue the run saved in this checkpoint instead of starting at epoch 0. With the same data, options
+        /// and optimizer the resumed run produces bit-for-bit the weights the uninterrupted run would have
+        std::string resume_from;
+
+        /// @brief Record per-epoch telemetry (phase and per-layer times, samples/s, training loss) into
+        /// TrainingResult::telemetry and, when telemetry_path is set, write it there as CSV (".csv") or JSON lines.
+        /// Both are ignored when the telemetry is compiled out (see diagnostics/telemetry.h)
+        bool record_telemetry = false;
+        std::string telemetry_path;
+    };
+
+    /// @brief Cost of the checkpoints of a training run
+    struct CheckpointStats{
+        size_t written = 0;
+        size_t superseded = 0;          // dropped because a newer checkpoint arrived before they were written
+        size_t failed = 0;
+        std::string last_error;
+        size_t bytes_written = 0;
+        double snapshot_seconds = 0;    // time the training loop spent copying state into snapshot buffers
+        double write_seconds = 0;       // time the background writer spent on disk, overlapped with training
+    };
+
+    struct TrainingResult{
+        int epochs_run = 0;
+        int best_epoch = 0;
+        double best_validation_rmse = std::numeric_limits<double>::infinity();
+        bool stopped_early = false;
+        CheckpointStats checkpoints;
+        std::vector<diagnostics::EpochTelemetry> telemetry;
+    };
+
+    /// @brief Where a training run stands after an epoch - everything besides the parameters, the optimizer
+    /// and the schedule that a checkpoint needs to continue it
+    struct TrainingProgress{
+        int next_epoch = 0;
+        int best_epoch = 0;
+        double best_validation_rmse = std::numeric_limits<double>::infinity();
+        int evaluations_without_improvement = 0;
+    };
+
+    /// @brief The loss curve of a learning rate range test and the learning rate picked from it
+    struct LearningRateSweep{
+        std::vector<double> learning_rates;
+        std::vector<double> losses;
+        std::vector<double> smoothed_losses;
+        double suggested_rate = 0;
+    };
+
+    /// @brief Wall-clock time spent in every stage of the background batch pipeline.
+    /// A trainer that spends a noticeable share of its time in input_wait is input bound, otherwise it is compute bound
+    struct PipelineStats{
+        double shuffle_seconds = 0;
+        double assemble_seconds = 0;
+        double normalize_seconds = 0;
+        double producer_wait_seconds = 0;
+        double input_wait_seconds = 0;
+        double compute_seconds = 0;
+        size_t batches = 0;
+    };
+
+    /// @brief A source of training rows that is read front to back one chunk at a time, for data sets
+    /// that do not fit into memory. Every row holds the inputs followed by the expected outputs
+    class SampleStream{
+        public:
+            virtual ~SampleStream() = default;
+
+            virtual size_t get_input_count() const = 0;
+            virtual size_t get_output_count() const = 0;
+
+            /// @brief Replaces rows with the next chunk of rows (row-major), false once the stream is exhausted
+            virtual bool next_chunk(std::vector<double>& rows) = 0;
+
+            /// @brief Starts over at the first row, e.g. for the next epoch
+            virtual void rewind() = 0;
     };
 
-    struct TrainingBatch{
-        lin_alg::Matrix inputs;
-        lin_alg::Matrix expected_outputs;
+    /// @brief Throughput and memory use of a streaming training run
+    struct StreamingStats{
+        size_t rows = 0;
+        double seconds = 0;
+        double rows_per_second = 0;
+        size_t buffered_bytes = 0;      // the shuffle buffer and the chunk being consumed, independent of the data set size
+        size_t peak_rss_bytes = 0;      // peak resident memory of the whole process
+    };
+
+    /// @brief Shape and activation of one layer of a network topology
+    struct LayerSpec{
+        size_t input_size;
+        size_t output_size;
+        std::shared_ptr<ActivationFunc> activation;
     };
 
     /// @brief A set of parameters between two neuron layers - the weight between the neurons of the n and n+1 layer 
@@ -33,25 +221,38 @@ namespace neural_network{
             lin_alg::Vector biases;
             
             std::shared_ptr<ActivationFunc> activate_function;
+            // activate_function's element kernel, resolved once when the layer is built
+            ActivationKernel kernel;
 
         public:
         
-            NNLayer(size_t input_size, size_t output_size, std::shared_ptr<ActivationFunc> act_func);
+            /// @brief Creates a layer with weights and biases drawn uniformly from [-1, 1) out of init
+            NNLayer(size_t input_size, size_t output_size, std::shared_ptr<ActivationFunc> act_func, RandomStream init);
+
+            /// @brief Creates a layer from existing parameters, which may be views into a mapped model file
+            NNLayer(lin_alg::Matrix weights, lin_alg::Vector biases, std::shared_ptr<ActivationFunc> act_func);
         
-            void initialize_params();
+            void initialize_params(RandomStream& stream);
 
             lin_alg::Vector forward(const lin_alg::Vector& input) const;  
             ForwardResult forward(const lin_alg::Matrix& input);
 
-            void update(const lin_alg::Matrix& weight_grad, const lin_alg::Vector& bias_grad);
+            /// @brief Lets the optimizer update the weights and biases in place.
+            /// The weights are registered with the optimizer as parameter 2 * layer_index, the biases as 2 * layer_index + 1
+            void update(Optimizer& optimizer, size_t layer_index, const LayerGradients& gradients, double learning_rate);
 
             lin_alg::Matrix get_weights() const { return weights; }
             lin_alg::Vector get_biases() const { return biases; }
 
             std::shared_ptr<ActivationFunc> get_activation() const;
 
+            /// @brief The activation as a kernel for std::visit, so batch loops call it without virtual dispatch
+            const ActivationKernel& get_kernel() const { return kernel; }
+
             lin_alg::Matrix& expose_weights();
             lin_alg::Vector& expose_biases();
+            const lin_alg::Matrix& expose_weights() const;
+            const lin_alg::Vector& expose_biases() const;
 
         };
         
@@ -65,34 +266,206 @@ namespace neural_network{
             // double learning_rate;
             int batch_size;
 
-            std::vector<lin_alg::Matrix> activations;
-            std::vector<lin_alg::Matrix> outputs;
+            std::shared_ptr<Optimizer> optimizer;
+            std::shared_ptr<Loss> loss;
+
+            ForwardContext context;
+
+            // keep the output of every checkpoint_every-th layer, 1 keeps all of them
+            size_t checkpoint_every = 1;
+
+            // inputs are normalized by input_normalizer before the first layer, outputs multiplied by output_scales after the last
+            Normalizer input_normalizer;
+            std::vector<double> output_scales;
+
+            // every random draw of the network comes from a stream of this seed (see RandomStreamKind),
+            // so checkpoints only need to keep the seed
+            uint64_t seed;
 
-            std::vector<TrainingBatch> NeuralNetwork::create_batches(const std::vector<TrainingSample>& training_data);
-            TrainingBatch NeuralNetwork::create_single_batch(const std::vector<TrainingSample>& training_data, size_t offset);
+            // the model file the layer parameters of a loaded network point into
+            std::shared_ptr<file_handling::MappedFile> model_mapping;
+
+            /// @brief Takes over ready-made layers, validating that their sizes chain up
+            NeuralNetwork(std::vector<NNLayer> layers, int batch_size, uint64_t seed);
+
+            /// @brief Cuts the data set into consecutive batches of batch_size rows (the last one may be shorter).
+            /// The batches view the data set, nothing is copied
+            std::vector<TrainingBatch> create_batches(Dataset& training_data) const;
+
+            /// @brief Throws unless the data set has as many inputs and outputs as the network
+            void check_dataset(const Dataset& data) const;
+
+            /// @brief Splits a batch into row ranges of (almost) equal size, one per training thread.
+            /// The shards view the batch's rows
+            std::vector<TrainingBatch> split_batch(TrainingBatch& batch, size_t shard_count) const;
 
             //forward calculations
             lin_alg::Vector predict(const lin_alg::Vector& input) const;
-            lin_alg::Matrix forward(const lin_alg::Matrix& input_batch);
+            /// @return The output of the last layer, held by ctx until its next forward pass
+            const lin_alg::Matrix& forward(const lin_alg::Matrix& input_batch, ForwardContext& ctx) const;
+            /// @brief Writes the output of layer i into out, and its pre-activation into *pre_activation when given
+            void forward_layer(size_t i, const lin_alg::Matrix& input, lin_alg::Matrix& out, lin_alg::Matrix* pre_activation = nullptr) const;
+            bool keeps_output(size_t i) const;
+            bool keeps_pre_activation(size_t i) const;
+
+            //backward calculations
+            /// @return The gradients of every layer, held by ctx until its next backward pass
+            const std::vector<LayerGradients>& compute_gradients(const TrainingBatch& batch, ForwardContext& ctx) const;
+
+            /// @brief Sums the gradients of all shards into the first one.
+            /// The pairs are combined in a fixed tree order, so the result only depends on the shard count
+            void reduce_gradients(std::vector<std::vector<LayerGradients>>& shard_gradients, parallel::ThreadPool& pool) const;
+
+            void apply_gradients(const std::vector<LayerGradients>& gradients, double learning_rate);
 
             void backward(const TrainingBatch& batch, double learning_rate);
 
-            double calc_rmse(const std::vector<lin_alg::Vector>& predicted_vals, const std::vector<lin_alg::Vector>& target_vals) const;
+            /// @param telemetry Receives the phase times and the loss of every batch, may be null
+            void train_epoch(EpochSampler& sampler, double learning_rate, diagnostics::TrainingTelemetry* telemetry);
+
+            void train_step_parallel(const std::vector<TrainingBatch>& shards, std::vector<ForwardContext>& replicas,
+                parallel::ThreadPool& pool, double learning_rate, diagnostics::TrainingTelemetry* telemetry);
+
+            /// @brief Mean loss of the batch of the last backward pass on ctx, see Loss::term_count
+            double batch_loss(const ForwardContext& ctx) const;
+
+            /// @brief Hands the summed loss of the last backward pass on ctx to the telemetry
+            void record_batch_loss(diagnostics::TrainingTelemetry& telemetry, const ForwardContext& ctx) const;
 
-            double calc_correlation(const std::vector<lin_alg::Vector>& predicted_vals, const std::vector<lin_alg::Vector>& target_vals) const;
+            double validation_rmse(const Dataset& validation_data) const;
 
-            lin_alg::Vector normalize_input(const lin_alg::Vector& input) const;
+            /// @brief predict_batch, with or without the input normalization
+            lin_alg::Matrix predict_rows(const lin_alg::Matrix& inputs, bool normalize_inputs) const;
 
-            lin_alg::Matrix normalize_inputs(const lin_alg::Matrix& inputs) const;
+            /// @brief evaluate, with or without the input normalization
+            RegressionMetrics evaluate_rows(const Dataset& data, bool normalize_inputs, size_t threads) const;
+
+            /// @brief Serializes the training state into buffer (see checkpoint.h), reusing its capacity.
+            /// best_layers may be nullptr when the run keeps no best weights
+            void serialize_checkpoint(std::vector<char>& buffer, const TrainingProgress& progress,
+                const std::vector<NNLayer>* best_layers, const LearningRateSchedule& schedule) const;
+
+            /// @brief Restores the parameters, RNG, optimizer and schedule state from a checkpoint file
+            TrainingProgress restore_checkpoint(const std::string& path, std::vector<NNLayer>& best_layers, LearningRateSchedule& schedule);
+
+            void denormalize_outputs_in_place(lin_alg::Matrix& outputs) const;
 
             lin_alg::Vector denormalize_output(const lin_alg::Vector& output) const;
 
         public:
 
-        NeuralNetwork(int batch_size);
+        /// @param seed Seeds the weights and every later random draw of the network (see set_seed)
+        NeuralNetwork(int batch_size, uint64_t seed = random_seed());
+
+        /// @brief Creates a network with the given layers; every layer's input size must match the previous output size.
+        /// The inputs and outputs are not scaled
+        /// @param seed Seeds the weights and every later random draw of the network (see set_seed)
+        NeuralNetwork(int batch_size, const std::vector<LayerSpec>& topology, uint64_t seed = random_seed());
+
+        /// @brief Writes the topology, activations, normalization parameters and weights to a binary model file (see model_file.h)
+        void save(const std::string& path) const;
+
+        /// @brief Maps a model file written by save() into memory. The weights are not copied: the layers point into
+        /// the mapping, so loading is independent of the model size and processes loading the same file share its pages.
+        /// Training a loaded network only copies the pages it writes to, the file itself never changes
+        static NeuralNetwork load(const std::string& path, int batch_size);
+
+        /// @brief Fits the input normalization to a training set (see Normalizer::fit) and makes it the network's
+        void fit_normalizer(const Dataset& data, NormalizationKind kind, size_t threads = 0);
+
+        /// @brief Replaces the input normalization; it must cover every input
+        void set_normalizer(Normalizer normalizer);
+        const Normalizer& get_normalizer() const { return input_normalizer; }
+
+        /// @brief Applies the input normalization to a data set in place. The Dataset overloads of train() and the
+        /// validation data take normalized data sets, so this runs once after loading instead of once per batch
+        void normalize(Dataset& data) const;
+
+        /// @brief Folds the input normalization into the first layer: W'[i][j] = W[i][j] / scale[i] and
+        /// b'[j] = b[j] - sum_i shift[i] / scale[i] * W[i][j]. Predictions stay the same up to rounding, but predict_batch
+        /// no longer spends a pass on normalizing. The normalizer becomes the identity, so call this once training is done
+        void fold_normalizer();
+
+        /// @brief Keeps only the output of every k-th layer (and the final one) during forward passes;
+        /// backward passes recompute the missing segments. 1 disables checkpointing
+        void set_activation_checkpointing(size_t every_k_layers);
+
+        /// @brief Activation memory and recompute counters of the single threaded training context
+        ActivationMemoryStats get_activation_stats() const;
+
+        /// @brief Replaces the optimizer used by every training method except train_async (plain SGD by default).
+        /// Copies of the network share the optimizer and its state
+        void set_optimizer(std::shared_ptr<Optimizer> optimizer);
+
+        /// @brief Replaces the loss every training method minimizes (MeanSquaredError by default). A loss fused with an
+        /// output activation (see Loss::fused_activation) needs the last layer to have that activation.
+        /// Copies of the network share the loss
+        void set_loss(std::shared_ptr<Loss> loss);
+        const Loss& get_loss() const { return *loss; }
+
+        /// @brief Replaces the seed of the epoch orders and the other draws of training. The weights of layer i are drawn
+        /// from stream (LayerInit, i) of the seed the network was created with; loaded networks get a random seed.
+        /// Two runs with the same seed, data and options train bitwise identical weights, on any thread count when
+        /// TrainingOptions::gradient_shards is set. train_async is the exception, its update order depends on scheduling
+        void set_seed(uint64_t seed) { this->seed = seed; }
+        uint64_t get_seed() const { return seed; }
+
+        /// @brief Trains the network with mini-batch gradient descent. A Dataset must already be normalized (see normalize),
+        /// the samples of the vector overloads are copied and normalized first
+        /// @param threads When greater than 1, every batch is split into one shard per thread and the shard
+        /// gradients are all-reduced before a single update. Results are bitwise reproducible for a given seed and thread count
+        void train(Dataset& training_data, int epochs, double learning_rate, size_t threads = 1);
+        void train(std::vector<TrainingSample>& training_data, int epochs, double learning_rate, size_t threads = 1);
+
+        /// @brief Trains with a learning rate schedule and, when validation data is given, evaluates the RMSE
+        /// every options.eval_every epochs, stops early once it stops improving and restores the best weights
+        TrainingResult train(Dataset& training_data, const TrainingOptions& options);
+        TrainingResult train(std::vector<TrainingSample>& training_data, const TrainingOptions& options);
+
+        /// @brief One forward pass, backward pass and optimizer update on a batch, the step train() takes for every batch.
+        /// The inputs must be normalized like the training data (see normalize). Once a batch of the size has gone through,
+        /// a step reuses the buffers of the last one and allocates nothing, unless activation checkpointing is on
+        /// @return The mean loss of the batch before the update
+        double train_batch(const TrainingBatch& batch, double learning_rate);
+
+        /// @brief Runs a short learning rate range test: trains on up to `steps` batches while the learning rate grows
+        /// exponentially from min_rate to max_rate, records the loss of every step and then restores the initial weights.
+        /// The optimizer state is reset afterwards
+        /// @param csv_path When not empty, the loss curve is written there as CSV
+        /// @return The loss curve and the learning rate where the smoothed loss falls fastest
+        LearningRateSweep find_learning_rate(std::vector<TrainingSample>& training_data, double min_rate = 1e-6, double max_rate = 10,
+            size_t steps = 300, const std::string& csv_path = "");
+
+        /// @brief Trains the network Hogwild-style: every worker pulls batches from a shared lock-free work queue,
+        /// computes gradients against the current weights and applies them to the shared parameters without locks.
+        /// Each epoch visits the batches in an order drawn from the seed. The first exception of a worker stops the others
+        /// and is rethrown once all of them have finished
+        AsyncTrainingStats train_async(std::vector<TrainingSample>& training_data, int epochs, double learning_rate, size_t threads);
+
+        /// @brief Trains on a stream of rows without ever holding the whole data set in memory. Rows go through a bounded
+        /// shuffle buffer: once it is full, every batch takes rows at random positions and the stream refills them,
+        /// so resident memory only depends on shuffle_buffer_rows and the stream's chunk size
+        StreamingStats train_streaming(SampleStream& stream, int epochs, double learning_rate, size_t shuffle_buffer_rows = 65536);
+
+        /// @brief Trains the network on batches that a background thread assembles, normalizes and shuffles
+        /// into a ring of preallocated buffers while the current batch trains
+        /// @param depth Number of batches the producer may prepare ahead of the trainer
+        PipelineStats train_pipelined(const std::vector<TrainingSample>& training_data, int epochs, double learning_rate, size_t depth = 2);
+
+        size_t get_input_size() const;
+        size_t get_output_size() const;
+
+        /// @brief Predicts a whole set of samples at once
+        /// @param inputs Raw (not normalized) inputs, one sample per row
+        /// @return The denormalized predictions, one row per sample. Rows are run through the layers in blocks
+        lin_alg::Matrix predict_batch(const lin_alg::Matrix& inputs) const;
 
-        void train(std::vector<TrainingSample>& training_data, int epochs, double learning_rate);
+        /// @brief Predicts a data set with raw inputs chunk by chunk and scores the predictions against its targets
+        /// without keeping them: every chunk feeds its own MetricAccumulator and the accumulators are merged in a fixed
+        /// pairwise tree, so the result does not depend on the thread count
+        RegressionMetrics evaluate(const Dataset& data, size_t threads = 1) const;
 
+        void test(const Dataset& test_data) const;
         void test(const std::vector<TrainingSample>& test_data) const;
         };        
 }
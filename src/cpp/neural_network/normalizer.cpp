@@ -0,0 +1,141 @@
+#include "normalizer.h"
+#include "../parallel/thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <format>
+
+namespace neural_network{
+
+    Normalizer::Normalizer(size_t feature_count)
+        : kind(NormalizationKind::Identity), shifts(feature_count, 0.0), scales(feature_count, 1.0) {}
+
+    Normalizer::Normalizer(NormalizationKind kind, std::vector<double> shifts, std::vector<double> scales)
+        : kind(kind), shifts(std::move(shifts)), scales(std::move(scales)) {
+        if (this->shifts.size() != this->scales.size()){
+            throw std::invalid_argument(std::format("Normalizer has {} shifts but {} scales", this->shifts.size(), this->scales.size()));
+        }
+        for (size_t i = 0; i < this->scales.size(); i++){
+            if (this->scales[i] == 0 || !std::isfinite(this->scales[i]) || !std::isfinite(this->shifts[i])){
+                throw std::invalid_argument(std::format("Feature {} has an invalid normalization: shift {}, scale {}", i, this->shifts[i], this->scales[i]));
+            }
+        }
+    }
+
+    Normalizer Normalizer::scaling(std::vector<double> divisors){
+        std::vector<double> shifts(divisors.size(), 0.0);
+        return Normalizer(NormalizationKind::Scale, std::move(shifts), std::move(divisors));
+    }
+
+    namespace{
+        // what one thread learned about one feature of its row range
+        struct FeatureSummary{
+            size_t count = 0;
+            double min = std::numeric_limits<double>::infinity();
+            double max = -std::numeric_limits<double>::infinity();
+            double mean = 0;
+            double squared_deviations = 0;
+
+            void add(double x){
+                count++;
+                min = std::min(min, x);
+                max = std::max(max, x);
+                double delta = x - mean;
+                mean += delta / count;
+                squared_deviations += delta * (x - mean);
+            }
+
+            // Chan et al.: combines the moments of two disjoint row ranges
+            void merge(const FeatureSummary& other){
+                if (other.count == 0) return;
+                const size_t total = count + other.count;
+                const double delta = other.mean - mean;
+                mean += delta * other.count / total;
+                squared_deviations += other.squared_deviations + delta * delta * (double(count) * other.count / total);
+                count = total;
+                min = std::min(min, other.min);
+                max = std::max(max, other.max);
+            }
+        };
+    }
+
+    Normalizer Normalizer::fit(const Dataset& data, NormalizationKind kind, size_t threads){
+        if (kind != NormalizationKind::MinMax && kind != NormalizationKind::Standard){
+            throw std::invalid_argument("Only MinMax and Standard normalizations can be fitted");
+        }
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+        const size_t rows = data.get_row_count();
+        const size_t cols = data.get_input_count();
+        const double* values = data.get_features().get_data();
+
+        // fixed-size row ranges, so the merge order - and with it the rounding - does not depend on the thread count
+        constexpr size_t range_rows = 4096;
+        const size_t range_count = (rows + range_rows - 1) / range_rows;
+        std::vector<std::vector<FeatureSummary>> summaries(range_count, std::vector<FeatureSummary>(cols));
+
+        auto summarize = [&](size_t range) {
+            std::vector<FeatureSummary>& summary = summaries[range];
+            const size_t end = std::min(rows, (range + 1) * range_rows);
+            for (size_t r = range * range_rows; r < end; r++){
+                for (size_t c = 0; c < cols; c++) summary[c].add(values[r * cols + c]);
+            }
+        };
+        if (threads > 1){
+            parallel::ThreadPool pool(threads);
+            pool.run(range_count, summarize);
+        }
+        else{
+            for (size_t range = 0; range < range_count; range++) summarize(range);
+        }
+
+        for (size_t range = 1; range < range_count; range++){
+            for (size_t c = 0; c < cols; c++) summaries[0][c].merge(summaries[range][c]);
+        }
+
+        std::vector<double> shifts(cols);
+        std::vector<double> scales(cols);
+        for (size_t c = 0; c < cols; c++){
+            const FeatureSummary& feature = summaries[0][c];
+            if (!std::isfinite(feature.min) || !std::isfinite(feature.max)){
+                throw std::invalid_argument(std::format("Feature {} contains values that are not finite", c));
+            }
+
+            double scale;
+            if (kind == NormalizationKind::MinMax){
+                shifts[c] = feature.min;
+                scale = feature.max - feature.min;
+            }
+            else{
+                shifts[c] = feature.mean;
+                scale = std::sqrt(feature.squared_deviations / feature.count);
+            }
+            scales[c] = scale > 0 ? scale : 1.0;
+        }
+
+        return Normalizer(kind, std::move(shifts), std::move(scales));
+    }
+
+    void Normalizer::apply(lin_alg::Matrix& inputs) const{
+        const size_t cols = inputs.get_cols_count();
+        if (cols != shifts.size()){
+            throw std::invalid_argument(std::format("Expected {} input columns, got {}", shifts.size(), cols));
+        }
+        if (is_identity()) return;
+
+        double* values = inputs.get_data();
+        for (size_t r = 0; r < inputs.get_rows_count(); ++r){
+            for (size_t c = 0; c < cols; ++c){
+                values[r * cols + c] = (values[r * cols + c] - shifts[c]) / scales[c];
+            }
+        }
+    }
+
+    bool Normalizer::is_identity() const{
+        for (size_t i = 0; i < shifts.size(); i++){
+            if (shifts[i] != 0 || scales[i] != 1) return false;
+        }
+        return true;
+    }
+}
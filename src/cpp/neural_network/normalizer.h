@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "dataset.h"
+
+namespace neural_network{
+
+    /// @brief How a Normalizer got its parameters. Stored in model files
+    enum class NormalizationKind : uint32_t{
+        Identity = 0,   // inputs pass through unchanged
+        Scale = 1,      // fixed divisors, no shift
+        MinMax = 2,     // fitted: every feature mapped onto [0, 1]
+        Standard = 3    // fitted: every feature shifted to mean 0 and scaled to standard deviation 1
+    };
+
+    /// @brief A per-feature affine input transform: x' = (x - shift) / scale.
+    /// Being affine, it can be folded into the weights and biases of the first layer once training is done
+    class Normalizer{
+        private:
+            NormalizationKind kind;
+            std::vector<double> shifts;
+            std::vector<double> scales;
+
+        public:
+            /// @brief Leaves feature_count features unchanged
+            explicit Normalizer(size_t feature_count = 0);
+
+            /// @brief Takes ready-made parameters; every scale must be non-zero
+            Normalizer(NormalizationKind kind, std::vector<double> shifts, std::vector<double> scales);
+
+            /// @brief Divides every feature by its divisor
+            static Normalizer scaling(std::vector<double> divisors);
+
+            /// @brief Fits MinMax or Standard parameters in one parallel pass over the features: every thread summarizes
+            /// a row range (min/max, or Welford's running mean and squared deviations) and the summaries are merged
+            /// in a fixed order, so the result does not depend on the thread count. Constant features keep a scale of 1
+            /// @param threads 0 uses every hardware thread
+            static Normalizer fit(const Dataset& data, NormalizationKind kind, size_t threads = 0);
+
+            /// @brief Normalizes every row of inputs in place
+            void apply(lin_alg::Matrix& inputs) const;
+
+            bool is_identity() const;
+
+            NormalizationKind get_kind() const { return kind; }
+            size_t get_feature_count() const { return shifts.size(); }
+            const std::vector<double>& get_shifts() const { return shifts; }
+            const std::vector<double>& get_scales() const { return scales; }
+    };
+}
@@ -0,0 +1,114 @@
+#include "optimizer.h"
+#include <cmath>
+#include <stdexcept>
+#include <format>
+
+namespace neural_network{
+
+    double* Optimizer::get_state(size_t param_id, size_t slot, size_t count){
+        if (slot >= state_slots){
+            throw std::out_of_range(std::format("Optimizer has {} state slots, requested slot {}", state_slots, slot));
+        }
+
+        size_t index = param_id * state_slots + slot;
+        if (index >= state.size()) state.resize(index + 1);
+
+        std::vector<double>& buffer = state[index];
+        if (buffer.size() != count) buffer.assign(count, 0.0);
+        return buffer.data();
+    }
+
+    void Optimizer::reset(){
+        state.clear();
+    }
+
+    std::vector<std::vector<double>> Optimizer::snapshot() const{
+        return state;
+    }
+
+    void Optimizer::restore(const std::vector<std::vector<double>>& snapshot){
+        if (state_slots == 0 ? !snapshot.empty() : snapshot.size() % state_slots != 0){
+            throw std::invalid_argument(std::format("Optimizer state with {} buffers does not fit {} state slots", snapshot.size(), state_slots));
+        }
+        state = snapshot;
+    }
+
+    void SGD::update(size_t, double* params, const double* grads, size_t count, double learning_rate){
+        double* __restrict p = params;
+        const double* __restrict g = grads;
+
+        for (size_t i = 0; i < count; i++){
+            p[i] -= learning_rate * g[i];
+        }
+    }
+
+    void Momentum::update(size_t param_id, double* params, const double* grads, size_t count, double learning_rate){
+        double* __restrict p = params;
+        const double* __restrict g = grads;
+        double* __restrict v = get_state(param_id, 0, count);
+
+        const double mu = momentum;
+        if (nesterov){
+            for (size_t i = 0; i < count; i++){
+                v[i] = mu * v[i] + g[i];
+                p[i] -= learning_rate * (g[i] + mu * v[i]);
+            }
+        }
+        else{
+            for (size_t i = 0; i < count; i++){
+                v[i] = mu * v[i] + g[i];
+                p[i] -= learning_rate * v[i];
+            }
+        }
+    }
+
+    void RMSProp::update(size_t param_id, double* params, const double* grads, size_t count, double learning_rate){
+        double* __restrict p = params;
+        const double* __restrict g = grads;
+        double* __restrict s = get_state(param_id, 0, count);
+
+        for (size_t i = 0; i < count; i++){
+            s[i] = rho * s[i] + (1 - rho) * g[i] * g[i];
+            p[i] -= learning_rate * g[i] / (std::sqrt(s[i]) + epsilon);
+        }
+    }
+
+    void Adam::update(size_t param_id, double* params, const double* grads, size_t count, double learning_rate){
+        if (step == 0) throw std::logic_error("Adam::begin_step must be called before the first update");
+
+        double* __restrict p = params;
+        const double* __restrict g = grads;
+        double* __restrict m = get_state(param_id, 0, count);
+        double* __restrict v = get_state(param_id, 1, count);
+
+        // the bias corrections of both moments are folded into the step size
+        const double step_size = learning_rate * std::sqrt(1 - std::pow(beta2, step)) / (1 - std::pow(beta1, step));
+        const double l2 = decoupled ? 0 : weight_decay;
+        const double decay = decoupled ? learning_rate * weight_decay : 0;
+
+        for (size_t i = 0; i < count; i++){
+            double grad = g[i] + l2 * p[i];
+            m[i] = beta1 * m[i] + (1 - beta1) * grad;
+            v[i] = beta2 * v[i] + (1 - beta2) * grad * grad;
+            p[i] -= step_size * m[i] / (std::sqrt(v[i]) + epsilon) + decay * p[i];
+        }
+    }
+
+    std::vector<std::vector<double>> Adam::snapshot() const{
+        std::vector<std::vector<double>> result = Optimizer::snapshot();
+        result.push_back({static_cast<double>(step)});
+        return result;
+    }
+
+    void Adam::restore(const std::vector<std::vector<double>>& snapshot){
+        if (snapshot.empty() || snapshot.back().size() != 1) throw std::invalid_argument("Adam state is missing its step count");
+
+        Optimizer::restore(std::vector<std::vector<double>>(snapshot.begin(), snapshot.end() - 1));
+        step = static_cast<size_t>(snapshot.back().front());
+    }
+
+    void Adam::reset(){
+        Optimizer::reset();
+        step = 0;
+    }
+}
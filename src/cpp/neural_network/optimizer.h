@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace neural_network{
+
+    /// @brief Turns parameter gradients into parameter updates.
+    /// Every parameter buffer (a layer's weights or biases) is identified by a stable id, under which
+    /// the optimizer keeps its per-parameter state (velocities, moment estimates...).
+    /// Each update is a single in-place pass over the parameter, gradient and state buffers
+    class Optimizer{
+        private:
+            size_t state_slots;
+            std::vector<std::vector<double>> state;
+
+        protected:
+            /// @brief The state buffer number slot of a parameter, zero-initialized on first use
+            double* get_state(size_t param_id, size_t slot, size_t count);
+
+        public:
+            explicit Optimizer(size_t state_slots) : state_slots(state_slots) {}
+            virtual ~Optimizer() = default;
+
+            /// @brief Marks the start of a training step, before the parameters of that step are updated
+            virtual void begin_step() {}
+
+            /// @brief Updates params in place, moving them against the loss gradient
+            virtual void update(size_t param_id, double* params, const double* grads, size_t count, double learning_rate) = 0;
+
+            /// @brief Drops all per-parameter state, e.g. before training a freshly initialized network
+            virtual void reset();
+
+            /// @brief Copies out everything the optimizer has accumulated, so a checkpointed run can continue exactly
+            virtual std::vector<std::vector<double>> snapshot() const;
+
+            /// @brief Puts back state taken by snapshot() of the same kind of optimizer
+            virtual void restore(const std::vector<std::vector<double>>& snapshot);
+    };
+
+    /// @brief Plain stochastic gradient descent: p -= lr * g
+    class SGD : public Optimizer{
+        public:
+            SGD() : Optimizer(0) {}
+
+            void update(size_t param_id, double* params, const double* grads, size_t count, double learning_rate) override;
+    };
+
+    /// @brief Heavy ball momentum: v = mu * v + g, p -= lr * v.
+    /// With nesterov set the step looks ahead along the velocity: p -= lr * (g + mu * v)
+    class Momentum : public Optimizer{
+        private:
+            double momentum;
+            bool nesterov;
+
+        public:
+            explicit Momentum(double momentum = 0.9, bool nesterov = false) : Optimizer(1), momentum(momentum), nesterov(nesterov) {}
+
+            void update(size_t param_id, double* params, const double* grads, size_t count, double learning_rate) override;
+    };
+
+    /// @brief Momentum with the Nesterov look-ahead step
+    class Nesterov : public Momentum{
+        public:
+            explicit Nesterov(double momentum = 0.9) : Momentum(momentum, true) {}
+    };
+
+    /// @brief Scales every step by a running average of the squared gradients: s = rho * s + (1 - rho) * g^2, p -= lr * g / (sqrt(s) + eps)
+    class RMSProp : public Optimizer{
+        private:
+            double rho;
+            double epsilon;
+
+        public:
+            explicit RMSProp(double rho = 0.9, double epsilon = 1e-8) : Optimizer(1), rho(rho), epsilon(epsilon) {}
+
+            void update(size_t param_id, double* params, const double* grads, size_t count, double learning_rate) override;
+    };
+
+    /// @brief Adam with bias-corrected first and second moment estimates.
+    /// A non-zero weight_decay is added to the gradient (L2 regularization), see AdamW for the decoupled variant
+    class Adam : public Optimizer{
+        private:
+            double beta1;
+            double beta2;
+            double epsilon;
+            double weight_decay;
+            bool decoupled;
+            size_t step = 0;
+
+        protected:
+            Adam(double beta1, double beta2, double epsilon, double weight_decay, bool decoupled)
+                : Optimizer(2), beta1(beta1), beta2(beta2), epsilon(epsilon), weight_decay(weight_decay), decoupled(decoupled) {}
+
+        public:
+            explicit Adam(double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8, double weight_decay = 0)
+                : Adam(beta1, beta2, epsilon, weight_decay, false) {}
+
+            void begin_step() override { step++; }
+
+            void update(size_t param_id, double* params, const double* grads, size_t count, double learning_rate) override;
+
+            void reset() override;
+
+            /// @brief The moment buffers followed by a single element buffer holding the step count
+            std::vector<std::vector<double>> snapshot() const override;
+            void restore(const std::vector<std::vector<double>>& snapshot) override;
+    };
+
+    /// @brief Adam with decoupled weight decay: p -= lr * (adam_step + weight_decay * p)
+    class AdamW : public Adam{
+        public:
+            explicit AdamW(double weight_decay = 0.01, double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8)
+                : Adam(beta1, beta2, epsilon, weight_decay, true) {}
+    };
+}
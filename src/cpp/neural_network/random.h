@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <random>
+#include <span>
+#include <utility>
+
+namespace neural_network{
+
+    /// @brief Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC 2011): a bijection of a
+    /// 128-bit counter keyed by 64 bits. Any block of any stream is computed directly from its counter, no state is carried
+    constexpr std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key){
+        constexpr uint32_t multiplier0 = 0xD2511F53;
+        constexpr uint32_t multiplier1 = 0xCD9E8D57;
+        constexpr uint32_t weyl0 = 0x9E3779B9;
+        constexpr uint32_t weyl1 = 0xBB67AE85;
+
+        for (int round = 0; round < 10; round++){
+            if (round > 0){
+                key[0] += weyl0;
+                key[1] += weyl1;
+            }
+            const uint64_t product0 = uint64_t(multiplier0) * counter[0];
+            const uint64_t product1 = uint64_t(multiplier1) * counter[2];
+            counter = {
+                uint32_t(product1 >> 32) ^ counter[1] ^ key[0], uint32_t(product1),
+                uint32_t(product0 >> 32) ^ counter[3] ^ key[1], uint32_t(product0)
+            };
+        }
+        return counter;
+    }
+
+    // known-answer vectors of the Random123 reference implementation (kat_vectors, philox4x32 with 10 rounds)
+    static_assert(philox4x32({0, 0, 0, 0}, {0, 0}) == std::array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+    static_assert(philox4x32({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff})
+        == std::array<uint32_t, 4>{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+    static_assert(philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0})
+        == std::array<uint32_t, 4>{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+
+    /// @brief What a random stream is used for. Together with an index (layer, epoch) it selects an independent
+    /// stream of a seed, so adding draws to one use never shifts the numbers another one sees. Never renumber them
+    enum class RandomStreamKind : uint32_t{
+        LayerInit = 1,          // index: layer
+        EpochOrder = 2,         // index: epoch
+        StreamingOrder = 3,     // index: epoch
+        PipelineOrder = 4       // index: epoch
+    };
+
+    /// @brief One Philox stream: key = the seed, counter = (position, kind, index). Satisfies UniformRandomBitGenerator,
+    /// but uniform(), below() and shuffle() are spelled out here rather than taken from <random>, whose distributions
+    /// differ between standard libraries - the numbers only depend on the seed, the kind and the index
+    class RandomStream{
+        private:
+            std::array<uint32_t, 2> key;
+            uint32_t kind;
+            uint32_t index;
+            uint64_t position = 0;
+            std::array<uint32_t, 4> block{};
+            size_t used = 4;
+
+        public:
+            using result_type = uint32_t;
+
+            RandomStream(uint64_t seed, RandomStreamKind kind, uint32_t index)
+                : key{uint32_t(seed), uint32_t(seed >> 32)}, kind(static_cast<uint32_t>(kind)), index(index) {}
+
+            static constexpr result_type min() { return 0; }
+            static constexpr result_type max() { return UINT32_MAX; }
+
+            result_type operator()(){
+                if (used == block.size()){
+                    block = philox4x32({uint32_t(position), uint32_t(position >> 32), kind, index}, key);
+                    position++;
+                    used = 0;
+                }
+                return block[used++];
+            }
+
+            uint64_t next_u64(){
+                const uint64_t high = (*this)();
+                return high << 32 | (*this)();
+            }
+
+            /// @brief Uniform in [0, 1), with the 53 bits a double holds
+            double uniform() { return (next_u64() >> 11) * 0x1.0p-53; }
+            double uniform(double low, double high) { return low + (high - low) * uniform(); }
+
+            /// @brief Uniform in [0, n) without modulo bias (Lemire's multiply and reject), n > 0
+            uint32_t below(uint32_t n){
+                uint64_t product = uint64_t((*this)()) * n;
+                if (uint32_t(product) < n){
+                    const uint32_t threshold = (0u - n) % n;
+                    while (uint32_t(product) < threshold) product = uint64_t((*this)()) * n;
+                }
+                return uint32_t(product >> 32);
+            }
+
+            /// @brief Fisher-Yates shuffle, values.size() must fit into 32 bits
+            template <typename T>
+            void shuffle(std::span<T> values){
+                for (size_t i = values.size(); i > 1; i--){
+                    std::swap(values[i - 1], values[below(static_cast<uint32_t>(i))]);
+                }
+            }
+    };
+
+    /// @brief A fresh seed from std::random_device, for runs that do not ask for a fixed one
+    inline uint64_t random_seed(){
+        std::random_device device;
+        return uint64_t(device()) << 32 | device();
+    }
+}
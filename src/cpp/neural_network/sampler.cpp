@@ -0,0 +1,123 @@
+#include "sampler.h"
+#include "../diagnostics/trace.h"
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <stdexcept>
+#include <format>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+namespace neural_network{
+
+    static inline void prefetch(const void* address){
+        #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+        #elif defined(__GNUC__)
+        __builtin_prefetch(address);
+        #else
+        (void)address;
+        #endif
+    }
+
+    void gather_rows(const double* source, size_t cols, const uint32_t* indices, size_t count, double* destination){
+        // far enough ahead to hide a cache miss behind the copies of the rows in between
+        constexpr size_t prefetch_distance = 8;
+        constexpr size_t line_values = 64 / sizeof(double);
+
+        for (size_t i = 0; i < count; i++){
+            if (i + prefetch_distance < count){
+                const double* ahead = source + size_t(indices[i + prefetch_distance]) * cols;
+                for (size_t c = 0; c < cols; c += line_values) prefetch(ahead + c);
+            }
+            std::copy_n(source + size_t(indices[i]) * cols, cols, destination + i * cols);
+        }
+    }
+
+    EpochSampler::EpochSampler(Dataset& data, size_t batch_size, SamplingMode mode, size_t strata_count)
+        : data(data), batch_size(batch_size), mode(mode), order(data.get_row_count()),
+          buffer(std::min(batch_size, data.get_row_count()), data.get_input_count(), data.get_output_count()) {
+        if (batch_size < 1) throw std::invalid_argument("Batch size must be >= 1");
+        if (data.get_row_count() > std::numeric_limits<uint32_t>::max()){
+            throw std::invalid_argument(std::format("The sampler indexes rows with 32 bits, the data set has {} rows", data.get_row_count()));
+        }
+        std::iota(order.begin(), order.end(), 0u);
+
+        if (mode == SamplingMode::Stratified){
+            if (strata_count < 1) throw std::invalid_argument("Stratified sampling needs at least one stratum");
+            strata_count = std::min(strata_count, data.get_row_count());
+
+            std::vector<uint32_t> by_target = order;
+            const double* targets = data.get_targets().get_data();
+            const size_t target_stride = data.get_output_count();
+            std::stable_sort(by_target.begin(), by_target.end(), [&](uint32_t a, uint32_t b) {
+                return targets[a * target_stride] < targets[b * target_stride];
+            });
+
+            const size_t rows = by_target.size();
+            for (size_t s = 0; s < strata_count; s++){
+                strata.emplace_back(by_target.begin() + s * rows / strata_count, by_target.begin() + (s + 1) * rows / strata_count);
+            }
+            interleave.resize(rows);
+        }
+    }
+
+    void EpochSampler::start_epoch(RandomStream& rng){
+        switch (mode){
+            case SamplingMode::Sequential:
+                break;
+            case SamplingMode::Shuffle:
+                // start from the identity every epoch, so the permutation depends on the RNG alone
+                std::iota(order.begin(), order.end(), 0u);
+                rng.shuffle(std::span(order));
+                break;
+            case SamplingMode::WithReplacement: {
+                const uint32_t rows = static_cast<uint32_t>(order.size());
+                for (uint32_t& index : order) index = rng.below(rows);
+                break;
+            }
+            case SamplingMode::Stratified:
+                start_stratified_epoch(rng);
+                break;
+        }
+    }
+
+    void EpochSampler::start_stratified_epoch(RandomStream& rng){
+        // every stratum is shuffled and its rows are spread evenly over the epoch: the i-th of n rows gets the
+        // position (i + jitter) / n, so consecutive rows of the merged order - and thereby every batch - draw
+        // from all strata in proportion to their size
+        size_t next = 0;
+
+        for (std::vector<uint32_t>& stratum : strata){
+            std::sort(stratum.begin(), stratum.end());
+            rng.shuffle(std::span(stratum));
+
+            const double size = static_cast<double>(stratum.size());
+            for (size_t i = 0; i < stratum.size(); i++){
+                interleave[next++] = {(i + rng.uniform()) / size, stratum[i]};
+            }
+        }
+
+        std::sort(interleave.begin(), interleave.end());
+        for (size_t i = 0; i < interleave.size(); i++) order[i] = interleave[i].second;
+    }
+
+    size_t EpochSampler::get_batch_count() const{
+        return (order.size() + batch_size - 1) / batch_size;
+    }
+
+    TrainingBatch EpochSampler::gather(size_t index){
+        diagnostics::TraceSpan span("data", "gather_batch", index);
+        const size_t offset = index * batch_size;
+        if (offset >= order.size()) throw std::out_of_range(std::format("Batch {} is out of range, the epoch has {}", index, get_batch_count()));
+        const size_t rows = std::min(batch_size, order.size() - offset);
+
+        if (mode == SamplingMode::Sequential) return data.batch(offset, rows);
+
+        gather_rows(data.get_features().get_data(), data.get_input_count(), order.data() + offset, rows, buffer.get_features().get_data());
+        gather_rows(data.get_targets().get_data(), data.get_output_count(), order.data() + offset, rows, buffer.get_targets().get_data());
+        return buffer.batch(0, rows);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "dataset.h"
+#include "random.h"
+
+namespace neural_network{
+
+    /// @brief The order an EpochSampler visits the rows of a data set in
+    enum class SamplingMode{
+        Sequential,         // rows in file order, every batch is a view into the data set
+        Shuffle,            // a fresh permutation every epoch, every row exactly once
+        WithReplacement,    // row_count rows drawn uniformly at random, rows may repeat or be left out
+        Stratified          // a fresh permutation in which every batch covers the target range evenly
+    };
+
+    /// @brief Draws the row order of every epoch as a permutation of 32-bit row indices and gathers each batch from the
+    /// data set into a reusable buffer. Only the indices are shuffled, the rows are never moved.
+    /// The order of an epoch only depends on the stream passed to start_epoch; training derives it from the network's
+    /// seed and the epoch number, so a run resumed from a checkpoint draws the same batches
+    class EpochSampler{
+        private:
+            Dataset& data;
+            size_t batch_size;
+            SamplingMode mode;
+
+            std::vector<uint32_t> order;
+
+            // Stratified: row indices sorted by the first target, cut into strata of (almost) equal size
+            std::vector<std::vector<uint32_t>> strata;
+            std::vector<std::pair<double, uint32_t>> interleave;
+
+            // the gathered rows of the current batch
+            Dataset buffer;
+
+            void start_stratified_epoch(RandomStream& rng);
+
+        public:
+            /// @param strata_count Number of target quantile ranges the Stratified mode spreads over every batch
+            EpochSampler(Dataset& data, size_t batch_size, SamplingMode mode, size_t strata_count = 10);
+
+            EpochSampler(const EpochSampler&) = delete;
+            EpochSampler& operator=(const EpochSampler&) = delete;
+
+            /// @brief Draws the row order of the next epoch
+            void start_epoch(RandomStream& rng);
+
+            size_t get_batch_count() const;
+
+            /// @brief Batch index of the current epoch. Sequential batches view the data set, the others are gathered into
+            /// the sampler's buffer and stay valid until the next call
+            TrainingBatch gather(size_t index);
+
+            const std::vector<uint32_t>& get_order() const { return order; }
+    };
+
+    /// @brief Copies the rows listed in indices from a row-major matrix into consecutive rows of destination,
+    /// prefetching the rows a few iterations ahead since shuffled rows defeat the hardware prefetcher
+    void gather_rows(const double* source, size_t cols, const uint32_t* indices, size_t count, double* destination);
+}
@@ -0,0 +1,81 @@
+#include "schedules.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <numbers>
+
+namespace neural_network{
+
+    double ConstantSchedule::rate(int){
+        return learning_rate;
+    }
+
+    StepSchedule::StepSchedule(double initial_rate, int step_epochs, double gamma)
+        : initial_rate(initial_rate), step_epochs(step_epochs), gamma(gamma) {
+        if (step_epochs < 1) throw std::invalid_argument("Step schedule needs step_epochs >= 1");
+    }
+
+    double StepSchedule::rate(int epoch){
+        return initial_rate * std::pow(gamma, epoch / step_epochs);
+    }
+
+    PiecewiseSchedule::PiecewiseSchedule(std::vector<std::pair<int, double>> milestones) : milestones(milestones) {
+        if (this->milestones.empty()) throw std::invalid_argument("Piecewise schedule needs at least one milestone");
+        std::sort(this->milestones.begin(), this->milestones.end());
+    }
+
+    double PiecewiseSchedule::rate(int epoch){
+        double result = milestones.front().second;
+        for (const std::pair<int, double>& milestone : milestones){
+            if (milestone.first > epoch) break;
+            result = milestone.second;
+        }
+        return result;
+    }
+
+    double ExponentialSchedule::rate(int epoch){
+        return initial_rate * std::pow(gamma, epoch);
+    }
+
+    CosineSchedule::CosineSchedule(double initial_rate, int total_epochs, double min_rate)
+        : initial_rate(initial_rate), min_rate(min_rate), total_epochs(total_epochs) {
+        if (total_epochs < 1) throw std::invalid_argument("Cosine schedule needs total_epochs >= 1");
+    }
+
+    double CosineSchedule::rate(int epoch){
+        double progress = std::min(1.0, static_cast<double>(epoch) / total_epochs);
+        return min_rate + 0.5 * (initial_rate - min_rate) * (1 + std::cos(std::numbers::pi * progress));
+    }
+
+    PlateauSchedule::PlateauSchedule(double initial_rate, double factor, int patience, double min_rate, double min_delta)
+        : current_rate(initial_rate), factor(factor), patience(patience), min_rate(min_rate), min_delta(min_delta) {}
+
+    double PlateauSchedule::rate(int){
+        return current_rate;
+    }
+
+    void PlateauSchedule::observe(double metric){
+        if (metric < best - min_delta){
+            best = metric;
+            evaluations_without_improvement = 0;
+            return;
+        }
+
+        if (++evaluations_without_improvement >= patience){
+            current_rate = std::max(min_rate, current_rate * factor);
+            evaluations_without_improvement = 0;
+        }
+    }
+
+    std::vector<double> PlateauSchedule::snapshot() const{
+        return {current_rate, best, static_cast<double>(evaluations_without_improvement)};
+    }
+
+    void PlateauSchedule::restore(const std::vector<double>& snapshot){
+        if (snapshot.size() != 3) throw std::invalid_argument("Plateau schedule state must hold 3 values");
+
+        current_rate = snapshot[0];
+        best = snapshot[1];
+        evaluations_without_improvement = static_cast<int>(snapshot[2]);
+    }
+}
\ No newline at end of file
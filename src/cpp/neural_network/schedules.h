@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <limits>
+
+namespace neural_network{
+
+    /// @brief Decides the learning rate of every epoch
+    class LearningRateSchedule{
+        public:
+            virtual ~LearningRateSchedule() = default;
+
+            /// @brief The learning rate to use for the given (zero based) epoch
+            virtual double rate(int epoch) = 0;
+
+            /// @brief Receives every validation result, lower is better. Only metric-driven schedules react to it
+            virtual void observe(double) {}
+
+            /// @brief The state a schedule has built up from observe(), for checkpoints. Stateless schedules return nothing
+            virtual std::vector<double> snapshot() const { return {}; }
+            virtual void restore(const std::vector<double>&) {}
+    };
+
+    class ConstantSchedule : public LearningRateSchedule{
+        private:
+            double learning_rate;
+
+        public:
+            explicit ConstantSchedule(double learning_rate) : learning_rate(learning_rate) {}
+
+            double rate(int epoch) override;
+    };
+
+    /// @brief Multiplies the learning rate by gamma every step_epochs epochs
+    class StepSchedule : public LearningRateSchedule{
+        private:
+            double initial_rate;
+            int step_epochs;
+            double gamma;
+
+        public:
+            StepSchedule(double initial_rate, int step_epochs, double gamma);
+
+            double rate(int epoch) override;
+    };
+
+    /// @brief Switches to a new learning rate at fixed epochs, e.g. {{0, 0.25}, {600, 0.15}, {1600, 0.05}}
+    class PiecewiseSchedule : public LearningRateSchedule{
+        private:
+            std::vector<std::pair<int, double>> milestones;
+
+        public:
+            explicit PiecewiseSchedule(std::vector<std::pair<int, double>> milestones);
+
+            double rate(int epoch) override;
+    };
+
+    /// @brief Decays the learning rate by gamma every epoch
+    class ExponentialSchedule : public LearningRateSchedule{
+        private:
+            double initial_rate;
+            double gamma;
+
+        public:
+            ExponentialSchedule(double initial_rate, double gamma) : initial_rate(initial_rate), gamma(gamma) {}
+
+            double rate(int epoch) override;
+    };
+
+    /// @brief Anneals the learning rate from initial_rate to min_rate along half a cosine over total_epochs
+    class CosineSchedule : public LearningRateSchedule{
+        private:
+            double initial_rate;
+            double min_rate;
+            int total_epochs;
+
+        public:
+            CosineSchedule(double initial_rate, int total_epochs, double min_rate = 0);
+
+            double rate(int epoch) override;
+    };
+
+    /// @brief Multiplies the learning rate by factor once the validation metric has not improved
+    /// by more than min_delta for patience consecutive evaluations
+    class PlateauSchedule : public LearningRateSchedule{
+        private:
+            double current_rate;
+            double factor;
+            int patience;
+            double min_rate;
+            double min_delta;
+
+            double best = std::numeric_limits<double>::infinity();
+            int evaluations_without_improvement = 0;
+
+        public:
+            PlateauSchedule(double initial_rate, double factor = 0.5, int patience = 3, double min_rate = 0, double min_delta = 0);
+
+            double rate(int epoch) override;
+
+            void observe(double metric) override;
+
+            std::vector<double> snapshot() const override;
+            void restore(const std::vector<double>& snapshot) override;
+    };
+}
@@ -0,0 +1,93 @@
+#include "neural_network.h"
+#include "../diagnostics/memory.h"
+#include <chrono>
+#include <algorithm>
+#include <format>
+#include <optional>
+
+namespace neural_network {
+
+    StreamingStats NeuralNetwork::train_streaming(SampleStream& stream, int epochs, double learning_rate, size_t shuffle_buffer_rows){
+        const size_t inputs = get_input_size();
+        const size_t outputs = get_output_size();
+        if (stream.get_input_count() != inputs || stream.get_output_count() != outputs){
+            throw std::invalid_argument(std::format("Stream rows have {} inputs and {} outputs, the network takes {} and {}",
+                stream.get_input_count(), stream.get_output_count(), inputs, outputs));
+        }
+        if (shuffle_buffer_rows == 0) throw std::invalid_argument("Shuffle buffer must hold at least one row");
+        if (shuffle_buffer_rows > UINT32_MAX) throw std::invalid_argument("Shuffle buffer must hold fewer than 2^32 rows");
+
+        const size_t cols = inputs + outputs;
+        const size_t rows_per_batch = static_cast<size_t>(batch_size);
+
+        // rows waiting to be drawn into a batch, row-major
+        std::vector<double> buffer;
+        buffer.reserve(shuffle_buffer_rows * cols);
+        size_t buffered_rows = 0;
+
+        std::vector<double> chunk;
+        size_t chunk_row = 0;
+
+        TrainingBatch batch(lin_alg::Matrix(rows_per_batch, inputs), lin_alg::Matrix(rows_per_batch, outputs));
+
+        StreamingStats stats;
+        auto start = std::chrono::steady_clock::now();
+
+        for (int epoch = 0; epoch < epochs; ++epoch){
+            RandomStream picks(seed, RandomStreamKind::StreamingOrder, static_cast<uint32_t>(epoch));
+            stream.rewind();
+            chunk.clear();
+            chunk_row = 0;
+            bool stream_open = true;
+
+            while (true){
+                // top the buffer up from the stream
+                while (buffered_rows < shuffle_buffer_rows){
+                    if (chunk_row * cols == chunk.size()){
+                        if (!stream_open || !(stream_open = stream.next_chunk(chunk))) break;
+                        chunk_row = 0;
+                        stats.buffered_bytes = std::max(stats.buffered_bytes, (buffer.capacity() + chunk.capacity()) * sizeof(double));
+                        continue;
+                    }
+
+                    size_t take = std::min(shuffle_buffer_rows - buffered_rows, chunk.size() / cols - chunk_row);
+                    buffer.insert(buffer.end(), chunk.begin() + chunk_row * cols, chunk.begin() + (chunk_row + take) * cols);
+                    buffered_rows += take;
+                    chunk_row += take;
+                }
+
+                if (buffered_rows == 0) break;
+
+                // draw the batch rows at random; the last buffered row fills every hole
+                const size_t rows = std::min(rows_per_batch, buffered_rows);
+                std::optional<TrainingBatch> tail;
+                if (rows < rows_per_batch) tail.emplace(lin_alg::Matrix(rows, inputs), lin_alg::Matrix(rows, outputs));
+                TrainingBatch& target = tail ? *tail : batch;
+                double* batch_inputs = target.inputs.get_data();
+                double* batch_outputs = target.expected_outputs.get_data();
+
+                for (size_t r = 0; r < rows; r++){
+                    double* row = buffer.data() + picks.below(static_cast<uint32_t>(buffered_rows)) * cols;
+
+                    std::copy_n(row, inputs, batch_inputs + r * inputs);
+                    std::copy_n(row + inputs, outputs, batch_outputs + r * outputs);
+
+                    buffered_rows--;
+                    std::copy_n(buffer.data() + buffered_rows * cols, cols, row);
+                }
+                buffer.resize(buffered_rows * cols);
+
+                input_normalizer.apply(target.inputs);
+                forward(target.inputs, context);
+                backward(target, learning_rate);
+                stats.rows += rows;
+            }
+        }
+
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.rows_per_second = stats.seconds > 0 ? stats.rows / stats.seconds : 0;
+        stats.peak_rss_bytes = diagnostics::peak_rss_bytes();
+        return stats;
+    }
+
+}
@@ -0,0 +1,91 @@
+#include "thread_pool.h"
+#include "../diagnostics/trace.h"
+#include <format>
+
+namespace parallel{
+
+    ThreadPool::ThreadPool(size_t thread_count){
+        size_t worker_count = thread_count > 1 ? thread_count - 1 : 0;
+        for (size_t i = 0; i < worker_count; i++){
+            workers.emplace_back([this, i]() {
+                diagnostics::set_trace_thread_name(std::format("pool worker {}", i + 1));
+                worker_loop();
+            });
+        }
+    }
+
+    ThreadPool::~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        job_ready.notify_all();
+        for (std::thread& worker : workers){
+            worker.join();
+        }
+    }
+
+    void ThreadPool::drain_tasks(){
+        for (size_t i = next_task.fetch_add(1); i < job_size; i = next_task.fetch_add(1)){
+            try{
+                (*job)(i);
+            }
+            catch (...){
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!first_error) first_error = std::current_exception();
+            }
+        }
+    }
+
+    void ThreadPool::worker_loop(){
+        size_t seen_generation = 0;
+        while (true){
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                job_ready.wait(lock, [&]() { return stopping || generation != seen_generation; });
+                if (stopping) return;
+                seen_generation = generation;
+            }
+
+            drain_tasks();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy_workers--;
+            }
+            job_done.notify_one();
+        }
+    }
+
+    void ThreadPool::run(size_t task_count, const std::function<void(size_t)>& task){
+        if (task_count == 0) return;
+
+        if (workers.empty() || task_count == 1){
+            for (size_t i = 0; i < task_count; i++) task(i);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &task;
+            job_size = task_count;
+            next_task = 0;
+            first_error = nullptr;
+            busy_workers = workers.size();
+            generation++;
+        }
+        job_ready.notify_all();
+
+        drain_tasks();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        job_done.wait(lock, [&]() { return busy_workers == 0; });
+        job = nullptr;
+
+        if (first_error){
+            std::exception_ptr error = first_error;
+            first_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+
+namespace parallel{
+
+    /// @brief A fixed set of worker threads that execute fork-join jobs.
+    /// The calling thread takes part in every job, so a pool of N threads starts N - 1 workers
+    class ThreadPool{
+
+        private:
+            std::vector<std::thread> workers;
+
+            std::mutex mutex;
+            std::condition_variable job_ready;
+            std::condition_variable job_done;
+
+            const std::function<void(size_t)>* job = nullptr;
+            size_t job_size = 0;
+            size_t generation = 0;
+            size_t busy_workers = 0;
+            bool stopping = false;
+
+            std::atomic<size_t> next_task{0};
+            std::exception_ptr first_error;
+
+            void worker_loop();
+            void drain_tasks();
+
+        public:
+
+            explicit ThreadPool(size_t thread_count);
+            ~ThreadPool();
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            size_t get_thread_count() const { return workers.size() + 1; }
+
+            /// @brief Runs task(i) for every i in [0, task_count) and blocks until all of them finish.
+            /// The first exception thrown by a task is rethrown on the calling thread
+            void run(size_t task_count, const std::function<void(size_t)>& task);
+    };
+}
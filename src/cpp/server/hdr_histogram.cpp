@@ -0,0 +1,83 @@
+#include "hdr_histogram.h"
+#include <bit>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace inference{
+
+    HdrHistogram::HdrHistogram(uint64_t highest_trackable, int significant_digits) : highest_trackable(highest_trackable) {
+        if (significant_digits < 1 || significant_digits > 5) throw std::invalid_argument("Significant digits must be between 1 and 5");
+        if (highest_trackable < 2) throw std::invalid_argument("Highest trackable value must be >= 2");
+
+        // enough linear sub-buckets per power of two to resolve significant_digits decimal digits
+        uint64_t largest_single_unit = 2 * static_cast<uint64_t>(std::pow(10, significant_digits));
+        int sub_bucket_count_magnitude = static_cast<int>(std::ceil(std::log2(static_cast<double>(largest_single_unit))));
+        sub_bucket_half_count_magnitude = std::max(sub_bucket_count_magnitude, 1) - 1;
+
+        uint64_t sub_bucket_count = 1ull << (sub_bucket_half_count_magnitude + 1);
+        sub_bucket_half_count = sub_bucket_count / 2;
+        sub_bucket_mask = sub_bucket_count - 1;
+
+        size_t bucket_count = 1;
+        for (uint64_t smallest_untrackable = sub_bucket_count; smallest_untrackable <= highest_trackable; smallest_untrackable <<= 1){
+            bucket_count++;
+            if (smallest_untrackable > (UINT64_MAX >> 1)) break;
+        }
+
+        counts.assign((bucket_count + 1) * sub_bucket_half_count, 0);
+    }
+
+    size_t HdrHistogram::index_of(uint64_t value) const{
+        int bucket_index = 64 - std::countl_zero(value | sub_bucket_mask) - (sub_bucket_half_count_magnitude + 1);
+        uint64_t sub_bucket_index = value >> bucket_index;
+        return (static_cast<size_t>(bucket_index + 1) << sub_bucket_half_count_magnitude) + (sub_bucket_index - sub_bucket_half_count);
+    }
+
+    uint64_t HdrHistogram::highest_equivalent_value(size_t index) const{
+        int bucket_index = static_cast<int>(index >> sub_bucket_half_count_magnitude) - 1;
+        uint64_t sub_bucket_index = (index & (sub_bucket_half_count - 1)) + sub_bucket_half_count;
+        if (bucket_index < 0){
+            sub_bucket_index -= sub_bucket_half_count;
+            bucket_index = 0;
+        }
+
+        uint64_t lowest = sub_bucket_index << bucket_index;
+        return lowest + (1ull << bucket_index) - 1;
+    }
+
+    void HdrHistogram::record(uint64_t value){
+        value = std::min(value, highest_trackable);
+        counts[index_of(value)]++;
+        total_count++;
+        max_value = std::max(max_value, value);
+        sum += static_cast<double>(value);
+    }
+
+    void HdrHistogram::merge(const HdrHistogram& other){
+        if (other.counts.size() != counts.size() || other.sub_bucket_half_count != sub_bucket_half_count){
+            throw std::invalid_argument("Only histograms with the same range and precision can be merged");
+        }
+
+        for (size_t i = 0; i < counts.size(); i++){
+            counts[i] += other.counts[i];
+        }
+        total_count += other.total_count;
+        max_value = std::max(max_value, other.max_value);
+        sum += other.sum;
+    }
+
+    uint64_t HdrHistogram::percentile(double percent) const{
+        if (total_count == 0) return 0;
+
+        percent = std::clamp(percent, 0.0, 100.0);
+        uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percent / 100 * total_count)));
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++){
+            seen += counts[i];
+            if (seen >= target) return std::min(highest_equivalent_value(i), max_value);
+        }
+        return max_value;
+    }
+}
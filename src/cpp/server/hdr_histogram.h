@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace inference{
+
+    /// @brief High dynamic range histogram: records integer values (e.g. latencies in ns) with a fixed
+    /// number of significant decimal digits, using log-linear buckets. Recording is O(1) and the memory
+    /// only depends on the trackable range and precision, never on the number of recorded values
+    class HdrHistogram{
+
+        private:
+            uint64_t highest_trackable;
+            int sub_bucket_half_count_magnitude;
+            uint64_t sub_bucket_half_count;
+            uint64_t sub_bucket_mask;
+
+            std::vector<uint64_t> counts;
+            uint64_t total_count = 0;
+            uint64_t max_value = 0;
+            double sum = 0;
+
+            size_t index_of(uint64_t value) const;
+            uint64_t highest_equivalent_value(size_t index) const;
+
+        public:
+
+            /// @param highest_trackable Larger values are clamped to it
+            /// @param significant_digits Precision of the recorded values, 1 to 5
+            explicit HdrHistogram(uint64_t highest_trackable = 60'000'000'000ull, int significant_digits = 3);
+
+            void record(uint64_t value);
+
+            /// @brief Adds the counts of a histogram with the same range and precision
+            void merge(const HdrHistogram& other);
+
+            /// @brief The value below which the given percentage (0 to 100) of the recorded values fall
+            uint64_t percentile(double percent) const;
+
+            uint64_t get_count() const { return total_count; }
+            uint64_t get_max() const { return max_value; }
+            double get_mean() const { return total_count > 0 ? sum / total_count : 0; }
+    };
+}
@@ -0,0 +1,224 @@
+#include "inference_server.h"
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <optional>
+#include <format>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace inference{
+
+    using Clock = std::chrono::steady_clock;
+
+    InferenceServer::Connection::~Connection(){
+        ::close(fd);
+    }
+
+    InferenceServer::InferenceServer(const neural_network::NeuralNetwork& network, const std::string& socket_path, BatchingOptions options)
+        : network(network), socket_path(socket_path), options(options), input_count(network.get_input_size()) {
+        if (options.max_batch_size == 0) throw std::invalid_argument("Max batch size must be >= 1");
+        if (options.send_timeout.count() <= 0) throw std::invalid_argument("Send timeout must be > 0");
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) throw std::invalid_argument("Socket path is too long: " + socket_path);
+        std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0) throw std::runtime_error(std::format("socket() failed: {}", std::strerror(errno)));
+
+        ::unlink(socket_path.c_str());
+        if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listen_fd, 128) < 0){
+            std::string message = std::format("Could not listen on {}: {}", socket_path, std::strerror(errno));
+            ::close(listen_fd);
+            throw std::runtime_error(message);
+        }
+    }
+
+    InferenceServer::~InferenceServer(){
+        stop();
+        ::close(listen_fd);
+        ::unlink(socket_path.c_str());
+    }
+
+    void InferenceServer::stop(){
+        stopping = true;
+    }
+
+    void InferenceServer::join_finished_readers(){
+        std::erase_if(readers, [](Reader& reader) {
+            if (!reader.done->load()) return false;
+            reader.thread.join();
+            return true;
+        });
+        std::erase_if(connections, [](const std::weak_ptr<Connection>& weak) { return weak.expired(); });
+    }
+
+    void InferenceServer::run(){
+        std::thread batcher([this]() { run_batches(); });
+
+        while (!stopping){
+            // poll with a timeout, so a stop request is noticed without another connection arriving
+            pollfd listener{listen_fd, POLLIN, 0};
+            if (::poll(&listener, 1, 200) <= 0) continue;
+
+            int fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) continue;
+
+            const long timeout_ms = static_cast<long>(options.send_timeout.count());
+            timeval send_timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+            if (::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout)) < 0){
+                ::close(fd);
+                continue;
+            }
+
+            std::shared_ptr<Connection> connection = std::make_shared<Connection>(fd);
+            std::shared_ptr<std::atomic<bool>> done = std::make_shared<std::atomic<bool>>(false);
+
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            join_finished_readers();
+            connections.push_back(connection);
+            readers.push_back(Reader{std::thread([this, connection, done]() {
+                read_requests(connection);
+                done->store(true);
+            }), done});
+        }
+
+        {
+            // unblock the readers, the sockets close once the last pending response is written
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            for (std::weak_ptr<Connection>& weak : connections){
+                if (std::shared_ptr<Connection> connection = weak.lock()) ::shutdown(connection->fd, SHUT_RD);
+            }
+        }
+        for (Reader& reader : readers){
+            reader.thread.join();
+        }
+        readers.clear();
+
+        // the batcher may be sleeping until its next report, wake it up so it drains the queue and exits
+        queue_changed.notify_all();
+        batcher.join();
+        report("Final latency report");
+    }
+
+    void InferenceServer::send_response(Connection& connection, const ResponseHeader& header, const double* outputs){
+        std::lock_guard<std::mutex> lock(connection.write_mutex);
+        if (connection.broken) return;
+
+        if (!write_all(connection.fd, &header, sizeof(header)) || !write_all(connection.fd, outputs, header.output_count * sizeof(double))){
+            // timed out or failed, possibly halfway through a response: the stream cannot be continued, and shutting it
+            // down also ends the connection's reader
+            connection.broken = true;
+            ::shutdown(connection.fd, SHUT_RDWR);
+        }
+    }
+
+    void InferenceServer::send_error(Connection& connection, uint32_t request_id, Status status){
+        send_response(connection, ResponseHeader{request_id, status, 0}, nullptr);
+    }
+
+    void InferenceServer::read_requests(std::shared_ptr<Connection> connection){
+        RequestHeader header;
+        while (!stopping && read_exact(connection->fd, &header, sizeof(header))){
+            if (header.magic != request_magic){
+                send_error(*connection, header.request_id, Status::bad_request);
+                break;  // the stream is out of sync, nothing after this can be trusted
+            }
+
+            // checked before allocating: input_count comes from the client. The payload of a bad request cannot be
+            // skipped safely, so the connection is dropped like for a bad magic
+            if (header.input_count != input_count){
+                send_error(*connection, header.request_id, Status::bad_request);
+                break;
+            }
+
+            std::vector<double> inputs(input_count);
+            if (!read_exact(connection->fd, inputs.data(), inputs.size() * sizeof(double))) break;
+
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                queue.push_back(PendingRequest{connection, header.request_id, std::move(inputs), Clock::now()});
+            }
+            queue_changed.notify_one();
+        }
+    }
+
+    void InferenceServer::run_batches(){
+        Clock::time_point next_report = Clock::now() + options.report_interval;
+        std::vector<PendingRequest> batch;
+
+        while (true){
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_changed.wait_until(lock, next_report, [&]() { return stopping || !queue.empty(); });
+
+                if (!queue.empty()){
+                    // hold the batch open until it is full or its oldest request hits the deadline
+                    Clock::time_point deadline = queue.front().received + options.max_delay;
+                    queue_changed.wait_until(lock, deadline, [&]() { return stopping || queue.size() >= options.max_batch_size; });
+
+                    size_t count = std::min(queue.size(), options.max_batch_size);
+                    for (size_t i = 0; i < count; i++){
+                        batch.push_back(std::move(queue.front()));
+                        queue.pop_front();
+                    }
+                }
+                else if (stopping){
+                    return;
+                }
+            }
+
+            if (!batch.empty()){
+                process_batch(batch);
+                batch.clear();
+            }
+
+            if (Clock::now() >= next_report){
+                if (latency_ns.get_count() > 0) report("Latency report");
+                next_report = Clock::now() + options.report_interval;
+            }
+        }
+    }
+
+    void InferenceServer::process_batch(std::vector<PendingRequest>& batch){
+        lin_alg::Matrix inputs(batch.size(), input_count);
+        double* rows = inputs.get_data();
+        for (size_t i = 0; i < batch.size(); i++){
+            std::copy(batch[i].inputs.begin(), batch[i].inputs.end(), rows + i * input_count);
+        }
+
+        std::optional<lin_alg::Matrix> outputs;
+        try{
+            outputs = network.predict_batch(inputs);
+        }
+        catch (const std::exception& e){
+            std::cerr << "Batch failed: " << e.what() << std::endl;
+            for (PendingRequest& request : batch){
+                send_error(*request.connection, request.request_id, Status::server_error);
+            }
+            return;
+        }
+
+        const size_t output_count = outputs->get_cols_count();
+        for (size_t i = 0; i < batch.size(); i++){
+            PendingRequest& request = batch[i];
+            ResponseHeader header{request.request_id, Status::ok, static_cast<uint16_t>(output_count)};
+            send_response(*request.connection, header, outputs->get_data() + i * output_count);
+
+            latency_ns.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - request.received).count());
+        }
+        batches++;
+    }
+
+    void InferenceServer::report(const char* title) const{
+        std::cout << title << ": " << latency_ns.get_count() << " requests in " << batches << " batches (mean batch "
+            << (batches > 0 ? static_cast<double>(latency_ns.get_count()) / batches : 0) << ")\n"
+            << "  p50 " << latency_ns.percentile(50) / 1000.0 << " us, p99 " << latency_ns.percentile(99) / 1000.0
+            << " us, p999 " << latency_ns.percentile(99.9) / 1000.0 << " us, max " << latency_ns.get_max() / 1000.0 << " us" << std::endl;
+    }
+}
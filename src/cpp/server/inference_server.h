@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "../neural_network/neural_network.h"
+#include "hdr_histogram.h"
+#include "protocol.h"
+
+namespace inference{
+
+    /// @brief Settings of the micro-batcher: a batch is dispatched as soon as it is full
+    /// or its oldest request has waited max_delay
+    struct BatchingOptions{
+        size_t max_batch_size = 64;
+        std::chrono::microseconds max_delay{500};
+        std::chrono::seconds report_interval{10};
+        // the batcher writes every response itself: a connection whose response does not go out within this is dropped,
+        // so a client that stops reading stalls the other connections once for at most this long
+        std::chrono::milliseconds send_timeout{100};
+    };
+
+    /// @brief Serves predictions of a trained network over a Unix domain socket.
+    /// Requests from all connections are coalesced into micro-batches that run through predict_batch
+    class InferenceServer{
+
+        private:
+            struct Connection{
+                int fd;
+                std::mutex write_mutex;
+                bool broken = false;    // a write failed or timed out, guarded by write_mutex
+
+                explicit Connection(int fd) : fd(fd) {}
+                ~Connection();
+            };
+
+            struct PendingRequest{
+                std::shared_ptr<Connection> connection;
+                uint32_t request_id;
+                std::vector<double> inputs;
+                std::chrono::steady_clock::time_point received;
+            };
+
+            const neural_network::NeuralNetwork& network;
+            std::string socket_path;
+            BatchingOptions options;
+            size_t input_count;
+
+            int listen_fd = -1;
+            std::atomic<bool> stopping{false};
+
+            std::mutex queue_mutex;
+            std::condition_variable queue_changed;
+            std::deque<PendingRequest> queue;
+
+            struct Reader{
+                std::thread thread;
+                std::shared_ptr<std::atomic<bool>> done;
+            };
+
+            std::mutex connections_mutex;
+            std::vector<std::weak_ptr<Connection>> connections;
+            std::vector<Reader> readers;
+
+            // only touched by the batcher thread
+            HdrHistogram latency_ns;
+            uint64_t batches = 0;
+
+            void read_requests(std::shared_ptr<Connection> connection);
+            void join_finished_readers();
+            void run_batches();
+            void process_batch(std::vector<PendingRequest>& batch);
+            void send_response(Connection& connection, const ResponseHeader& header, const double* outputs);
+            void send_error(Connection& connection, uint32_t request_id, Status status);
+            void report(const char* title) const;
+
+        public:
+
+            InferenceServer(const neural_network::NeuralNetwork& network, const std::string& socket_path, BatchingOptions options = {});
+            ~InferenceServer();
+
+            InferenceServer(const InferenceServer&) = delete;
+            InferenceServer& operator=(const InferenceServer&) = delete;
+
+            /// @brief Accepts connections and serves requests until stop() is called
+            void run();
+
+            /// @brief Makes run() return after the queued requests are answered.
+            /// Only sets an atomic flag, so it is safe to call from any thread and from signal handlers
+            void stop();
+    };
+}
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "protocol.h"
+#include "hdr_histogram.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct ClientResult{
+    inference::HdrHistogram latency_ns;
+    uint64_t errors = 0;
+};
+
+static int connect_to(const std::string& socket_path){
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0){
+        const int error = errno;    // close() may overwrite it
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("Could not connect to " + socket_path + ": " + std::strerror(error));
+    }
+    return fd;
+}
+
+/// @brief Keeps `depth` requests in flight on one connection until `requests` have been answered
+static void run_client(const std::string& socket_path, size_t requests, size_t depth, uint32_t input_count, unsigned seed, ClientResult& result){
+    int fd = connect_to(socket_path);
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<> dist(0.0, 10.0);
+
+    std::vector<Clock::time_point> sent_at(requests);
+    std::vector<double> payload(input_count);
+    size_t sent = 0;
+
+    auto send_next = [&]() {
+        for (double& value : payload) value = dist(gen);
+        inference::RequestHeader header{inference::request_magic, static_cast<uint32_t>(sent), input_count};
+        sent_at[sent] = Clock::now();
+        sent++;
+        return inference::write_all(fd, &header, sizeof(header)) && inference::write_all(fd, payload.data(), payload.size() * sizeof(double));
+    };
+
+    bool ok = true;
+    while (ok && sent < std::min(depth, requests)) ok = send_next();
+
+    std::vector<double> outputs;
+    for (size_t received = 0; ok && received < requests; received++){
+        inference::ResponseHeader header;
+        if (!inference::read_exact(fd, &header, sizeof(header))) break;
+
+        outputs.resize(header.output_count);
+        if (!inference::read_exact(fd, outputs.data(), outputs.size() * sizeof(double))) break;
+
+        if (header.status != inference::Status::ok || header.request_id >= requests) result.errors++;
+        else result.latency_ns.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sent_at[header.request_id]).count());
+
+        if (sent < requests) ok = send_next();
+    }
+
+    ::close(fd);
+}
+
+int main(int argc, char* argv[]){
+    if (argc < 2){
+        std::cerr << "Usage: nn_loadgen <socket path> [connections] [requests per connection] [in-flight per connection] [inputs]" << std::endl;
+        return 1;
+    }
+
+    std::string socket_path = argv[1];
+    size_t connections = argc > 2 ? std::stoul(argv[2]) : 8;
+    size_t requests = argc > 3 ? std::stoul(argv[3]) : 10000;
+    size_t depth = argc > 4 ? std::stoul(argv[4]) : 1;
+    uint32_t input_count = argc > 5 ? static_cast<uint32_t>(std::stoul(argv[5])) : 4;
+
+    std::vector<ClientResult> results(connections);
+    std::vector<std::thread> clients;
+
+    auto start = Clock::now();
+    for (size_t c = 0; c < connections; c++){
+        clients.emplace_back([&, c]() {
+            try{
+                run_client(socket_path, requests, depth, input_count, static_cast<unsigned>(c), results[c]);
+            }
+            catch (const std::exception& e){
+                std::cerr << e.what() << std::endl;
+                results[c].errors++;
+            }
+        });
+    }
+    for (std::thread& client : clients){
+        client.join();
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+
+    ClientResult total;
+    for (const ClientResult& result : results){
+        total.latency_ns.merge(result.latency_ns);
+        total.errors += result.errors;
+    }
+
+    std::cout << total.latency_ns.get_count() << " responses (" << total.errors << " errors) in " << elapsed.count() << " s: "
+        << total.latency_ns.get_count() / elapsed.count() << " requests/s\n"
+        << "p50 " << total.latency_ns.percentile(50) / 1000.0 << " us, p99 " << total.latency_ns.percentile(99) / 1000.0
+        << " us, p999 " << total.latency_ns.percentile(99.9) / 1000.0 << " us, max " << total.latency_ns.get_max() / 1000.0 << " us" << std::endl;
+}
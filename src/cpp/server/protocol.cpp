@@ -0,0 +1,27 @@
+#include "protocol.h"
+#include <sys/socket.h>
+
+namespace inference{
+
+    bool read_exact(int fd, void* buffer, size_t size){
+        char* out = static_cast<char*>(buffer);
+        while (size > 0){
+            ssize_t n = ::recv(fd, out, size, 0);
+            if (n <= 0) return false;
+            out += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool write_all(int fd, const void* buffer, size_t size){
+        const char* in = static_cast<const char*>(buffer);
+        while (size > 0){
+            ssize_t n = ::send(fd, in, size, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            in += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+}
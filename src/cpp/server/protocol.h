@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+
+namespace inference{
+
+    // Wire format, all fields little-endian:
+    //   request:  RequestHeader followed by input_count doubles
+    //   response: ResponseHeader followed by output_count doubles (none unless status is ok)
+    // A connection may pipeline any number of requests, responses carry the request_id they answer
+    // and can arrive out of order.
+
+    static_assert(std::endian::native == std::endian::little, "The wire format is little-endian and sent as-is");
+
+    constexpr uint32_t request_magic = 0x51524E4E; // "NNRQ"
+
+    struct RequestHeader{
+        uint32_t magic;
+        uint32_t request_id;
+        uint32_t input_count;
+    };
+
+    enum class Status : uint16_t{
+        ok = 0,
+        bad_request = 1,
+        server_error = 2
+    };
+
+    struct ResponseHeader{
+        uint32_t request_id;
+        Status status;
+        uint16_t output_count;
+    };
+
+    static_assert(sizeof(RequestHeader) == 12 && sizeof(ResponseHeader) == 8, "Wire headers must not contain padding");
+
+    /// @brief Reads exactly size bytes, false on EOF or error
+    bool read_exact(int fd, void* buffer, size_t size);
+
+    /// @brief Writes all size bytes, false on error
+    bool write_all(int fd, const void* buffer, size_t size);
+}
@@ -0,0 +1,47 @@
+#include <iostream>
+#include <string>
+#include <csignal>
+#include <chrono>
+#include "inference_server.h"
+
+static inference::InferenceServer* running_server = nullptr;
+
+static void handle_signal(int){
+    if (running_server != nullptr) running_server->stop();
+}
+
+int main(int argc, char* argv[]){
+    if (argc < 3){
+        std::cerr << "Usage: nn_server <socket path> <model file> [max batch size] [max delay us]" << std::endl;
+        return 1;
+    }
+
+    std::string socket_path = argv[1];
+
+    inference::BatchingOptions options;
+    if (argc > 3) options.max_batch_size = std::stoul(argv[3]);
+    if (argc > 4) options.max_delay = std::chrono::microseconds(std::stoul(argv[4]));
+
+    try{
+        auto start = std::chrono::steady_clock::now();
+        neural_network::NeuralNetwork network = neural_network::NeuralNetwork::load(argv[2], 20);
+        // the server never trains, so the input normalization can live in the first layer
+        network.fold_normalizer();
+        std::chrono::duration<double, std::milli> load_time = std::chrono::steady_clock::now() - start;
+        std::cout << "Loaded " << argv[2] << " in " << load_time.count() << " ms" << std::endl;
+
+        inference::InferenceServer server(network, socket_path, options);
+        running_server = &server;
+        std::signal(SIGINT, handle_signal);
+        std::signal(SIGTERM, handle_signal);
+
+        std::cout << "Serving on " << socket_path << " (max batch " << options.max_batch_size << ", max delay "
+            << options.max_delay.count() << " us)" << std::endl;
+        server.run();
+        running_server = nullptr;
+    }
+    catch (const std::exception& e){
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}